@@ -0,0 +1,155 @@
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+
+#include <tbb/parallel_for.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/range/adaptors.hpp>
+
+#include "chrono.hpp"
+#include "io/geojson_writer.hpp"
+
+namespace bg = boost::geometry;
+namespace ba = boost::adaptors;
+
+// the ostream based printer that GeoJSONWriter replaces
+template <typename Feature, typename Geometry>
+void legacy_print(std::ofstream & os, const std::vector<Feature> & features,
+                  const char * type, Geometry Feature::*geometry) {
+    for(const auto & e : features | ba::indexed(0)) {
+        os << "{\"type\":\"Feature\",\"geometry\":{\"type\":\"" << type
+           << "\",\"coordinates\":"
+           << bg::dsv(e.value().*geometry, ",", "[", "]", ",", "[", "]", ",")
+           << "},\"properties\":{"
+           << boost::algorithm::join(
+                  e.value().properties | ba::transformed([](const auto & p) {
+                      return "\"" + std::string(p.first) + "\":\"" +
+                             std::string(p.second) + "\"";
+                  }),
+                  ",")
+           << "}}"
+           << (e.index() + 1 != static_cast<std::ptrdiff_t>(features.size())
+                   ? ","
+                   : "");
+    }
+}
+
+void legacy_print_geojson(const std::vector<Node> & nodes,
+                          const std::vector<Way> & ways,
+                          const std::vector<Area> & areas,
+                          const std::filesystem::path & json_file) {
+    std::ofstream json(json_file);
+    json << std::setprecision(std::numeric_limits<double>::max_digits10);
+    json << "{\"type\":\"FeatureCollection\",\"features\":[";
+    legacy_print(json, nodes, "Point", &Node::point);
+    if(nodes.size() > 0) json << ",";
+    legacy_print(json, ways, "LineString", &Way::linestring);
+    if(nodes.size() + ways.size() > 0) json << ",";
+    legacy_print(json, areas, "MultiPolygon", &Area::multipolygon);
+    json << "]}";
+}
+
+void writer_print_geojson(const std::vector<Node> & nodes,
+                          const std::vector<Way> & ways,
+                          const std::vector<Area> & areas,
+                          const std::filesystem::path & json_file,
+                          int precision,
+                          IO::Compression compression = IO::Compression::none,
+                          bool parallel = false) {
+    IO::GeoJSONWriter writer(json_file, precision, 1 << 20, compression);
+    auto write = [&writer, parallel](const auto & features) {
+        if(!parallel) {
+            for(const auto & feature : features) writer.write(feature);
+            return;
+        }
+        tbb::parallel_for(std::size_t{0}, features.size(), [&](std::size_t i) {
+            writer.write(features[i]);
+        });
+    };
+    write(nodes);
+    write(ways);
+    write(areas);
+    writer.close();
+}
+
+// the throughput is the one of the uncompressed output, if given its size
+template <typename F>
+double run(const std::string & name, const std::filesystem::path & file, F && f,
+           double plain_mb = 0) {
+    Chrono chrono;
+    f();
+    const double seconds = chrono.timeUs() / 1e6;
+    const double mb = std::filesystem::file_size(file) / 1e6;
+    std::cout << std::left << std::setw(24) << name << std::right
+              << std::setw(10) << std::fixed << std::setprecision(1) << mb
+              << " MB " << std::setw(10) << std::setprecision(3) << seconds
+              << " s " << std::setw(10) << std::setprecision(1)
+              << (plain_mb > 0 ? plain_mb : mb) / seconds << " MB/s"
+              << std::endl;
+    return mb;
+}
+
+int main(int argc, char * argv[]) {
+    const std::size_t nb_features =
+        argc > 1 ? std::stoul(argv[1]) : std::size_t{100000};
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> lon(-5.0, 8.0);
+    std::uniform_real_distribution<double> lat(42.0, 51.0);
+    std::uniform_real_distribution<double> offset(-0.001, 0.001);
+    const std::vector<std::pair<std::string, std::string>> tags = {
+        {"name", "Forêt domaniale de Brocéliande"},
+        {"probConnectionPerMeter", "0.95"},
+        {"qualityCoef", "1"}};
+    const Properties properties(tags);
+
+    std::vector<Node> nodes;
+    std::vector<Way> ways;
+    std::vector<Area> areas;
+    for(std::size_t i = 0; i < nb_features; ++i) {
+        PointGeo p(lon(gen), lat(gen));
+        nodes.emplace_back(p, properties);
+
+        LinestringGeo l;
+        for(int j = 0; j < 20; ++j)
+            l.emplace_back(p.x() + offset(gen), p.y() + offset(gen));
+        ways.emplace_back(std::move(l), properties);
+
+        MultipolygonGeo mp;
+        RingGeo & ring = mp.emplace_back().outer();
+        for(int j = 0; j < 50; ++j)
+            ring.emplace_back(p.x() + offset(gen), p.y() + offset(gen));
+        ring.push_back(ring.front());
+        areas.emplace_back(std::move(mp), properties);
+    }
+
+    const std::filesystem::path file =
+        std::filesystem::temp_directory_path() / "osm2geojson_benchmark.json";
+    run("ostream printer", file,
+        [&] { legacy_print_geojson(nodes, ways, areas, file); });
+    run("writer shortest", file,
+        [&] { writer_print_geojson(nodes, ways, areas, file, -1); });
+    const double plain_mb =
+        run("writer 7 decimals", file,
+            [&] { writer_print_geojson(nodes, ways, areas, file, 7); });
+    run("parallel 7 decimals", file, [&] {
+        writer_print_geojson(nodes, ways, areas, file, 7,
+                             IO::Compression::none, true);
+    });
+    for(IO::Compression compression :
+        {IO::Compression::gzip, IO::Compression::zstd}) {
+        const std::string name = IO::compression_name(compression);
+        run(name, file, [&] {
+            writer_print_geojson(nodes, ways, areas, file, 7, compression);
+        }, plain_mb);
+        run("parallel " + name, file, [&] {
+            writer_print_geojson(nodes, ways, areas, file, 7, compression,
+                                 true);
+        }, plain_mb);
+    }
+    std::filesystem::remove(file);
+}
@@ -0,0 +1,122 @@
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bg_types.hpp"
+#include "chrono.hpp"
+#include "io/geojson_parser.hpp"
+#include "prepared_search_area.hpp"
+
+// star shaped area of many vertices around Paris, when no area file is given
+MultipolygonGeo synthetic_area(std::size_t nb_vertices) {
+    MultipolygonGeo area;
+    RingGeo & ring = area.emplace_back().outer();
+    for(std::size_t i = 0; i < nb_vertices; ++i) {
+        // clockwise
+        const double angle = -2 * M_PI * static_cast<double>(i) / nb_vertices;
+        const double radius = (i % 2 == 0) ? 1.0 : 0.8;
+        ring.emplace_back(2.35 + radius * std::cos(angle),
+                          48.85 + radius * std::sin(angle));
+    }
+    ring.push_back(ring.front());
+    return area;
+}
+
+std::vector<MultipolygonGeo> load_areas(const std::string & area_file) {
+    simdjson::ondemand::parser parser;
+    auto json = simdjson::padded_string::load(area_file);
+    auto doc = parser.iterate(json);
+    std::vector<MultipolygonGeo> areas;
+    for(auto feature : doc.find_field("features").get_array()) {
+        auto geometry = feature.find_field_unordered("geometry");
+        if(geometry.find_field("type") != "MultiPolygon") continue;
+        areas.push_back(
+            IO::detail::parse_geojson_multipolygon<MultipolygonGeo>(
+                geometry.find_field("coordinates").get_array()));
+    }
+    return areas;
+}
+
+struct Result {
+    double points_ns;
+    double linestrings_ns;
+    std::vector<bool> answers;
+};
+
+// max_grid_size 1 sends every entity of the area box to the exact test
+Result run(const MultipolygonGeo & area, PredicateCS cs,
+           std::size_t max_grid_size, const std::vector<PointGeo> & points,
+           const std::vector<LinestringGeo> & linestrings) {
+    const PreparedSearchArea prepared(area, cs, max_grid_size);
+    Result result;
+    result.answers.reserve(points.size() + linestrings.size());
+    Chrono chrono;
+    for(const PointGeo & p : points)
+        result.answers.push_back(prepared.intersects(p));
+    result.points_ns = chrono.lapTimeUs() * 1e3 / points.size();
+    for(const LinestringGeo & l : linestrings)
+        result.answers.push_back(prepared.covered_by(l));
+    result.linestrings_ns = chrono.lapTimeUs() * 1e3 / linestrings.size();
+    return result;
+}
+
+int main(int argc, char * argv[]) {
+    const std::size_t nb_objects =
+        argc > 2 ? std::stoul(argv[2]) : std::size_t{10000};
+    std::vector<MultipolygonGeo> areas =
+        argc > 1 ? load_areas(argv[1])
+                 : std::vector<MultipolygonGeo>{synthetic_area(2000)};
+
+    std::mt19937 gen(42);
+    std::cout << std::setw(6) << "area" << std::setw(12) << "cs"
+              << std::setw(8) << "grid" << std::setw(14) << "point ns"
+              << std::setw(14) << "line ns" << std::setw(14)
+              << "disagree" << std::endl;
+    for(std::size_t a = 0; a < areas.size(); ++a) {
+        const MultipolygonGeo & area = areas[a];
+        const BoxGeo box = boost::geometry::return_envelope<BoxGeo>(area);
+        std::uniform_real_distribution<double> x_dist(box.min_corner().x(),
+                                                      box.max_corner().x());
+        std::uniform_real_distribution<double> y_dist(box.min_corner().y(),
+                                                      box.max_corner().y());
+        // ways of a few short segments
+        std::uniform_real_distribution<double> step_dist(-0.01, 0.01);
+        std::vector<PointGeo> points;
+        std::vector<LinestringGeo> linestrings(nb_objects);
+        for(std::size_t i = 0; i < nb_objects; ++i)
+            points.emplace_back(x_dist(gen), y_dist(gen));
+        for(LinestringGeo & l : linestrings) {
+            l.emplace_back(x_dist(gen), y_dist(gen));
+            for(int k = 0; k < 4; ++k)
+                l.emplace_back(l.back().x() + step_dist(gen),
+                               l.back().y() + step_dist(gen));
+        }
+
+        for(std::size_t max_grid_size : {std::size_t{1}, std::size_t{1024}}) {
+            const Result reference = run(area, PredicateCS::geographic,
+                                         max_grid_size, points, linestrings);
+            for(const auto & [cs, name] :
+                {std::make_pair(PredicateCS::cartesian, "cartesian"),
+                 std::make_pair(PredicateCS::spherical, "spherical"),
+                 std::make_pair(PredicateCS::geographic, "geographic")}) {
+                const Result result =
+                    cs == PredicateCS::geographic
+                        ? reference
+                        : run(area, cs, max_grid_size, points, linestrings);
+                std::size_t disagreements = 0;
+                for(std::size_t i = 0; i < reference.answers.size(); ++i)
+                    disagreements +=
+                        (result.answers[i] != reference.answers[i]);
+                std::cout << std::setw(6) << a << std::setw(12) << name
+                          << std::setw(8) << max_grid_size << std::setw(14)
+                          << std::fixed << std::setprecision(1)
+                          << result.points_ns << std::setw(14)
+                          << result.linestrings_ns << std::setw(14)
+                          << disagreements << std::endl;
+            }
+        }
+    }
+}
@@ -0,0 +1,90 @@
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "chrono.hpp"
+#include "rules_index.hpp"
+
+using TagViews = std::vector<std::pair<std::string_view, std::string_view>>;
+
+// the linear scan of the rules that RulesIndex replaces
+template <typename Rules>
+const typename Rules::value_type * linear_find(const Rules & rules,
+                                               const TagViews & tags) {
+    for(const auto & rule : rules)
+        if(RulesIndex<int>::fusion_test(tags, rule.first)) return &rule;
+    return nullptr;
+}
+
+int main(int argc, char * argv[]) {
+    const std::size_t nb_objects =
+        argc > 1 ? std::stoul(argv[1]) : std::size_t{1000000};
+
+    std::mt19937 gen(42);
+    const std::vector<std::string> rule_keys = {"landuse", "leisure",
+                                                "natural", "waterway"};
+    const std::vector<std::string> other_keys = {
+        "building", "highway", "name", "source", "surface", "wikidata"};
+
+    std::cout << std::setw(8) << "rules" << std::setw(16) << "linear ns/obj"
+              << std::setw(16) << "index ns/obj" << std::endl;
+    for(std::size_t nb_rules : {10, 50, 150, 500, 2000}) {
+        std::vector<RulesIndex<int>::Rule> rules;
+        for(std::size_t i = 0; i < nb_rules; ++i)
+            rules.emplace_back(
+                RulesIndex<int>::Filter{{rule_keys[i % rule_keys.size()],
+                                         osmium::StringMatcher::equal(
+                                             "value" + std::to_string(i))}},
+                static_cast<int>(i));
+        RulesIndex<int> index(rules);
+
+        // objects have a few tags, some of them with a value used by a rule
+        std::vector<std::string> strings;
+        strings.reserve(nb_objects * 8);
+        std::vector<TagViews> objects(nb_objects);
+        std::uniform_int_distribution<std::size_t> value_dist(0, 2 * nb_rules);
+        std::uniform_int_distribution<std::size_t> nb_tags_dist(0, 4);
+        for(TagViews & tags : objects) {
+            const std::size_t nb_tags = nb_tags_dist(gen);
+            for(std::size_t j = 0; j < nb_tags; ++j) {
+                const std::vector<std::string> & keys =
+                    j == 0 ? rule_keys : other_keys;
+                strings.push_back(
+                    "value" + std::to_string(value_dist(gen)));
+                tags.emplace_back(keys[(j + value_dist(gen)) % keys.size()],
+                                  strings.back());
+            }
+            std::sort(tags.begin(), tags.end());
+            tags.erase(std::unique(tags.begin(), tags.end(),
+                                   [](const auto & t1, const auto & t2) {
+                                       return t1.first == t2.first;
+                                   }),
+                       tags.end());
+        }
+
+        std::size_t linear_matches = 0;
+        Chrono chrono;
+        for(const TagViews & tags : objects)
+            if(const auto * rule = linear_find(rules, tags))
+                linear_matches += static_cast<std::size_t>(rule->second);
+        const double linear_ns = chrono.lapTimeUs() * 1e3 / nb_objects;
+
+        std::size_t index_matches = 0;
+        for(const TagViews & tags : objects)
+            if(const auto * rule = index.find(tags))
+                index_matches += static_cast<std::size_t>(rule->second);
+        const double index_ns = chrono.lapTimeUs() * 1e3 / nb_objects;
+
+        if(linear_matches != index_matches) {
+            std::cerr << "RulesIndex results differ from the linear scan"
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << std::setw(8) << nb_rules << std::setw(16) << std::fixed
+                  << std::setprecision(1) << linear_ns << std::setw(16)
+                  << index_ns << std::endl;
+    }
+}
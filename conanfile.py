@@ -14,6 +14,7 @@ class CompressorRecipe(ConanFile):
         self.requires("onetbb/2021.10.0")
         self.requires("expat/2.5.0")
         self.requires("zlib/[>=1.2.0]")
+        self.requires("zstd/1.5.5")
         # self.requires("json-schema-validator/2.2.0")
         # self.requires("parallel-hashmap/1.37")
         # self.requires("fmt/10.1.1")
@@ -1,16 +1,30 @@
 #ifndef BG_TYPES_HPP
 #define BG_TYPES_HPP
 
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
 #include <boost/geometry.hpp>
+#include <boost/geometry/geometries/register/point.hpp>
 
 using PointGeo = boost::geometry::model::d2::point_xy<
     double, boost::geometry::cs::geographic<boost::geometry::degree>>;
 using BoxGeo = boost::geometry::model::box<PointGeo>;
 using LinestringGeo = boost::geometry::model::linestring<PointGeo>;
+using MultilinestringGeo =
+    boost::geometry::model::multi_linestring<LinestringGeo>;
 using RingGeo = boost::geometry::model::ring<PointGeo>;
 using PolygonGeo = boost::geometry::model::polygon<PointGeo>;
 using MultipolygonGeo = boost::geometry::model::multi_polygon<PolygonGeo>;
 
+using PointSph = boost::geometry::model::d2::point_xy<
+    double, boost::geometry::cs::spherical_equatorial<boost::geometry::degree>>;
+using LinestringSph = boost::geometry::model::linestring<PointSph>;
+using PolygonSph = boost::geometry::model::polygon<PointSph>;
+using MultipolygonSph = boost::geometry::model::multi_polygon<PolygonSph>;
+
 using Point2D = boost::geometry::model::d2::point_xy<double>;
 using Box2D = boost::geometry::model::box<Point2D>;
 using Linestring2D = boost::geometry::model::linestring<Point2D>;
@@ -18,4 +32,57 @@ using Ring2D = boost::geometry::model::ring<Point2D>;
 using Polygon2D = boost::geometry::model::polygon<Point2D>;
 using Multipolygon2D = boost::geometry::model::multi_polygon<Polygon2D>;
 
+/**
+ * @brief Geographic point stored as two int32 of 1e-7 degrees, the precision
+ * of the OSM locations, in half the size of a PointGeo. Its coordinates are
+ * read and written as doubles, thus the boost::geometry algorithms apply.
+ */
+class PointFixed {
+private:
+    static constexpr double precision = 1e7;
+
+    std::int32_t fixed_x;
+    std::int32_t fixed_y;
+
+    static std::int32_t to_fixed(double c) noexcept {
+        return static_cast<std::int32_t>(std::lround(c * precision));
+    }
+
+public:
+    PointFixed() noexcept : fixed_x(0), fixed_y(0) {}
+    PointFixed(double x, double y) noexcept
+        : fixed_x(to_fixed(x)), fixed_y(to_fixed(y)) {}
+
+    // the quotient gives the double nearest to the decimal coordinate
+    double x() const noexcept { return fixed_x / precision; }
+    double y() const noexcept { return fixed_y / precision; }
+    void x(double c) noexcept { fixed_x = to_fixed(c); }
+    void y(double c) noexcept { fixed_y = to_fixed(c); }
+};
+
+BOOST_GEOMETRY_REGISTER_POINT_2D_GET_SET(
+    PointFixed, double,
+    boost::geometry::cs::geographic<boost::geometry::degree>, x, y, x, y)
+
+// storage types of the result geometries, converted from the Geo ones
+using LinestringFixed = boost::geometry::model::linestring<PointFixed>;
+using RingFixed = boost::geometry::model::ring<PointFixed>;
+using PolygonFixed = boost::geometry::model::polygon<PointFixed>;
+using MultipolygonFixed = boost::geometry::model::multi_polygon<PolygonFixed>;
+
+/**
+ * @brief Converts between the Geo and Fixed geometries, the geometry itself
+ * if it already has the target type.
+ */
+template <typename Target, typename Geometry>
+Target convert_geometry(Geometry && g) {
+    if constexpr(std::is_same_v<std::decay_t<Geometry>, Target>) {
+        return std::forward<Geometry>(g);
+    } else {
+        Target target;
+        boost::geometry::convert(g, target);
+        return target;
+    }
+}
+
 #endif  // BG_TYPES_HPP
\ No newline at end of file
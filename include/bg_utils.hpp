@@ -1,6 +1,11 @@
 #ifndef BG_UTILS_HPP
 #define BG_UTILS_HPP
 
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
 #include "bg_types.hpp"
 
 #include <boost/geometry/srs/epsg.hpp>
@@ -24,12 +29,43 @@ Multipolygon2D buffer2D(T && g, float width) {
     return mp2d;
 }
 
-template <class Point>
-MultipolygonGeo buffer_PointGeo(Point && p, float width) {
-    boost::geometry::srs::projection<> proj = boost::geometry::srs::proj4(
-        "+proj=eqc +ellps=GRS80 +lon_0=" + std::to_string(p.x()) +
-        " +lat_0=" + std::to_string(p.y()));
+/**
+ * @brief Equidistant cylindrical projections, true to scale at the center of
+ * the 1 degree tile of the projected geometry, shared by the geometries of
+ * a tile instead of being built for each of them.
+ *
+ * Not thread safe, each thread should use its own cache.
+ */
+class ProjectionCache {
+private:
+    std::unordered_map<std::int64_t, boost::geometry::srs::projection<>>
+        projections;
+
+public:
+    const boost::geometry::srs::projection<> & get(const PointGeo & center) {
+        const double lon = std::floor(center.x());
+        const double lat = std::floor(center.y());
+        const std::int64_t tile =
+            static_cast<std::int64_t>(lon + 180) * 1000 +
+            static_cast<std::int64_t>(lat + 90);
+        auto it = projections.find(tile);
+        if(it == projections.end()) {
+            const std::string lon_0 = std::to_string(lon + 0.5);
+            const std::string lat_0 = std::to_string(lat + 0.5);
+            it = projections
+                     .emplace(tile, boost::geometry::srs::proj4(
+                                        "+proj=eqc +ellps=GRS80 +lon_0=" +
+                                        lon_0 + " +lat_0=" + lat_0 +
+                                        " +lat_ts=" + lat_0))
+                     .first;
+        }
+        return it->second;
+    }
+};
 
+template <class Point>
+MultipolygonGeo buffer_PointGeo(
+    Point && p, float width, const boost::geometry::srs::projection<> & proj) {
     MultipolygonGeo mp;
 
     Point2D p2d;
@@ -40,14 +76,26 @@ MultipolygonGeo buffer_PointGeo(Point && p, float width) {
     return mp;
 }
 
-template <class Linestring>
-MultipolygonGeo buffer_LinestringGeo(Linestring && l, float width) {
-    PointGeo center = boost::geometry::return_centroid<PointGeo>(
-        boost::geometry::return_envelope<BoxGeo>(l));
+template <class Point>
+MultipolygonGeo buffer_PointGeo(Point && p, float width) {
     boost::geometry::srs::projection<> proj = boost::geometry::srs::proj4(
-        "+proj=eqc +ellps=GRS80 +lon_0=" + std::to_string(center.x()) +
-        " +lat_0=" + std::to_string(center.y()));
+        "+proj=eqc +ellps=GRS80 +lon_0=" + std::to_string(p.x()) +
+        " +lat_0=" + std::to_string(p.y()));
+    return buffer_PointGeo(std::forward<Point>(p), width, proj);
+}
 
+template <class Linestring>
+PointGeo envelope_center(Linestring && l) {
+    const BoxGeo envelope = boost::geometry::return_envelope<BoxGeo>(l);
+    return PointGeo(
+        (envelope.min_corner().x() + envelope.max_corner().x()) / 2,
+        (envelope.min_corner().y() + envelope.max_corner().y()) / 2);
+}
+
+template <class Linestring>
+MultipolygonGeo buffer_LinestringGeo(
+    Linestring && l, float width,
+    const boost::geometry::srs::projection<> & proj) {
     MultipolygonGeo mp;
 
     Linestring2D l2d;
@@ -86,4 +134,13 @@ MultipolygonGeo buffer_LinestringGeo(Linestring && l, float width) {
     return mp;
 }
 
+template <class Linestring>
+MultipolygonGeo buffer_LinestringGeo(Linestring && l, float width) {
+    PointGeo center = envelope_center(l);
+    boost::geometry::srs::projection<> proj = boost::geometry::srs::proj4(
+        "+proj=eqc +ellps=GRS80 +lon_0=" + std::to_string(center.x()) +
+        " +lat_0=" + std::to_string(center.y()));
+    return buffer_LinestringGeo(std::forward<Linestring>(l), width, proj);
+}
+
 #endif  // BG_UTILS_HPP
\ No newline at end of file
@@ -0,0 +1,334 @@
+#ifndef BG_VALIDATION_HPP
+#define BG_VALIDATION_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/geometry.hpp>
+#include <boost/geometry/index/rtree.hpp>
+
+#include "bg_types.hpp"
+
+/**
+ * @brief How the geometries built from the OSM entities are validated.
+ *
+ * none: only the number of points is checked.
+ * fast: linear time structural checks of the rings, closure, orientation,
+ *       non zero area and inner rings inside the outer ring envelope.
+ * full: boost::geometry::is_valid, the invalid geometries are discarded.
+ * repair: boost::geometry::is_valid, the invalid geometries are repaired
+ *         and discarded only if the repair fails.
+ */
+enum class ValidationMode { none, fast, full, repair };
+
+inline ValidationMode validation_mode_from_string(const std::string & name) {
+    if(name == "none") return ValidationMode::none;
+    if(name == "fast") return ValidationMode::fast;
+    if(name == "full") return ValidationMode::full;
+    if(name == "repair") return ValidationMode::repair;
+    throw std::invalid_argument("unknown validation mode " + name);
+}
+
+/**
+ * @brief Reasons why the geometry of a matched OSM entity is discarded.
+ */
+enum class GeometryError : unsigned char {
+    none,
+    invalid_location,
+    few_points,
+    not_closed,
+    wrong_orientation,
+    zero_area,
+    spikes,
+    self_intersections,
+    interior_rings_outside,
+    invalid,  // other failures of boost::geometry::is_valid
+    repair_failed,
+    other  // unexpected exception while building the feature
+};
+
+constexpr std::size_t nb_geometry_errors =
+    static_cast<std::size_t>(GeometryError::other) + 1;
+
+inline const char * geometry_error_name(GeometryError error) noexcept {
+    switch(error) {
+        case GeometryError::none:
+            return "none";
+        case GeometryError::invalid_location:
+            return "invalid location";
+        case GeometryError::few_points:
+            return "too few points";
+        case GeometryError::not_closed:
+            return "ring not closed";
+        case GeometryError::wrong_orientation:
+            return "wrong ring orientation";
+        case GeometryError::zero_area:
+            return "ring with zero area";
+        case GeometryError::spikes:
+            return "spikes";
+        case GeometryError::self_intersections:
+            return "self intersections";
+        case GeometryError::interior_rings_outside:
+            return "inner ring outside";
+        case GeometryError::invalid:
+            return "invalid geometry";
+        case GeometryError::repair_failed:
+            return "repair failed";
+        default:
+            return "other";
+    }
+}
+
+inline GeometryError to_geometry_error(
+    boost::geometry::validity_failure_type failure) noexcept {
+    switch(failure) {
+        case boost::geometry::no_failure:
+            return GeometryError::none;
+        case boost::geometry::failure_few_points:
+        case boost::geometry::failure_wrong_topological_dimension:
+            return GeometryError::few_points;
+        case boost::geometry::failure_not_closed:
+            return GeometryError::not_closed;
+        case boost::geometry::failure_wrong_orientation:
+            return GeometryError::wrong_orientation;
+        case boost::geometry::failure_spikes:
+            return GeometryError::spikes;
+        case boost::geometry::failure_self_intersections:
+        case boost::geometry::failure_intersecting_interiors:
+        case boost::geometry::failure_disconnected_interior:
+            return GeometryError::self_intersections;
+        case boost::geometry::failure_interior_rings_outside:
+        case boost::geometry::failure_nested_interior_rings:
+            return GeometryError::interior_rings_outside;
+        default:
+            return GeometryError::invalid;
+    }
+}
+
+/**
+ * The reason why boost::geometry::is_valid rejects the geometry, without
+ * building its failure message.
+ */
+template <typename Geometry>
+GeometryError validity_error(const Geometry & g) {
+    boost::geometry::validity_failure_type failure;
+    boost::geometry::is_valid(g, failure);
+    return to_geometry_error(failure);
+}
+
+namespace detail {
+// twice the signed area of the ring in the longitude latitude plane,
+// positive for counterclockwise rings
+template <typename Ring>
+double shoelace(const Ring & ring) {
+    double sum = 0;
+    for(std::size_t i = 1; i < ring.size(); ++i)
+        sum += ring[i - 1].x() * ring[i].y() - ring[i].x() * ring[i - 1].y();
+    return sum;
+}
+
+// hash of the coordinates of a point
+struct CoordinatesHash {
+    std::size_t operator()(
+        const std::pair<double, double> & coordinates) const noexcept {
+        const std::size_t h = std::hash<double>{}(coordinates.first);
+        return h ^ (std::hash<double>{}(coordinates.second) +
+                    0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2));
+    }
+};
+
+// intersection point of the segments [a,b] and [c,d] in the longitude
+// latitude plane, if they properly cross
+template <typename Point>
+bool crossing_point(const Point & a, const Point & b, const Point & c,
+                    const Point & d, Point & crossing) {
+    const double d1x = b.x() - a.x(), d1y = b.y() - a.y();
+    const double d2x = d.x() - c.x(), d2y = d.y() - c.y();
+    const double denom = d1x * d2y - d1y * d2x;
+    if(denom == 0) return false;
+    const double t = ((c.x() - a.x()) * d2y - (c.y() - a.y()) * d2x) / denom;
+    const double u = ((c.x() - a.x()) * d1y - (c.y() - a.y()) * d1x) / denom;
+    if(t <= 0 || t >= 1 || u <= 0 || u >= 1) return false;
+    crossing = Point(a.x() + t * d1x, a.y() + t * d1y);
+    return true;
+}
+
+/**
+ * Splits a closed ring at its self crossings and repeated points into
+ * simple closed rings, dropping the spikes and the degenerate rings.
+ */
+template <typename Ring>
+std::vector<Ring> split_ring(Ring ring) {
+    boost::geometry::remove_spikes(ring);
+    if(ring.size() < 4) return {};
+    using Point = typename boost::range_value<Ring>::type;
+    using RTree =
+        boost::geometry::index::rtree<std::pair<Box2D, std::size_t>,
+                                      boost::geometry::index::rstar<16>>;
+    const std::size_t nb_segments = ring.size() - 1;
+    auto envelope = [&ring](std::size_t i) {
+        const Point & a = ring[i];
+        const Point & b = ring[i + 1];
+        return Box2D(Point2D(std::min(a.x(), b.x()), std::min(a.y(), b.y())),
+                     Point2D(std::max(a.x(), b.x()), std::max(a.y(), b.y())));
+    };
+    std::vector<std::pair<Box2D, std::size_t>> envelopes;
+    for(std::size_t i = 0; i < nb_segments; ++i)
+        envelopes.emplace_back(envelope(i), i);
+    const RTree segments_rtree(envelopes);
+
+    // crossing points inserted in each segment, sorted along the segment
+    std::vector<std::vector<std::pair<double, Point>>> crossings(nb_segments);
+    for(std::size_t i = 0; i < nb_segments; ++i) {
+        for(auto it = segments_rtree.qbegin(
+                boost::geometry::index::intersects(envelope(i)));
+            it != segments_rtree.qend(); ++it) {
+            const std::size_t j = it->second;
+            Point crossing;
+            if(j <= i || !crossing_point(ring[i], ring[i + 1], ring[j],
+                                         ring[j + 1], crossing))
+                continue;
+            auto position = [&crossing](const Point & origin) {
+                return std::abs(crossing.x() - origin.x()) +
+                       std::abs(crossing.y() - origin.y());
+            };
+            crossings[i].emplace_back(position(ring[i]), crossing);
+            crossings[j].emplace_back(position(ring[j]), crossing);
+        }
+    }
+    std::vector<Point> points;
+    for(std::size_t i = 0; i < nb_segments; ++i) {
+        points.push_back(ring[i]);
+        std::sort(crossings[i].begin(), crossings[i].end(),
+                  [](const auto & c1, const auto & c2) {
+                      return c1.first < c2.first;
+                  });
+        for(const auto & c : crossings[i]) points.push_back(c.second);
+    }
+    points.push_back(ring.front());
+
+    // a loop is closed each time the path comes back to one of its points,
+    // found by the position in the path of each of them
+    std::vector<Ring> loops;
+    std::vector<Point> path;
+    std::unordered_map<std::pair<double, double>, std::size_t,
+                       CoordinatesHash>
+        positions;
+    auto coordinates = [](const Point & p) {
+        return std::make_pair(p.x(), p.y());
+    };
+    for(const Point & p : points) {
+        const auto [it, inserted] =
+            positions.emplace(coordinates(p), path.size());
+        if(inserted) {
+            path.push_back(p);
+            continue;
+        }
+        const auto first = path.begin() + static_cast<std::ptrdiff_t>(
+                                              it->second);
+        Ring loop(first, path.end());
+        loop.push_back(p);
+        // the path keeps the first point of the loop
+        for(auto q = std::next(first); q != path.end(); ++q)
+            positions.erase(coordinates(*q));
+        path.erase(std::next(first), path.end());
+        if(loop.size() >= 4 && shoelace(loop) != 0)
+            loops.push_back(std::move(loop));
+    }
+    return loops;
+}
+}  // namespace detail
+
+/**
+ * Checks the rings of a polygon in linear time, returns the first error
+ * found among unclosed, degenerate or wrongly oriented rings and inner rings
+ * outside of the envelope of the outer ring.
+ */
+template <typename Polygon>
+GeometryError fast_check_polygon(const Polygon & polygon) noexcept {
+    auto check_ring = [](const auto & ring, bool is_outer) {
+        if(ring.size() < 4) return GeometryError::few_points;
+        if(!boost::geometry::equals(ring.front(), ring.back()))
+            return GeometryError::not_closed;
+        const double area = detail::shoelace(ring);
+        if(area == 0) return GeometryError::zero_area;
+        // outer rings are clockwise and inner rings counterclockwise
+        if((area < 0) != is_outer) return GeometryError::wrong_orientation;
+        return GeometryError::none;
+    };
+    const auto & outer = polygon.outer();
+    if(GeometryError error = check_ring(outer, true);
+       error != GeometryError::none)
+        return error;
+    if(polygon.inners().empty()) return GeometryError::none;
+    Box2D outer_box = boost::geometry::make_inverse<Box2D>();
+    for(const auto & p : outer)
+        boost::geometry::expand(outer_box, Point2D(p.x(), p.y()));
+    for(const auto & inner : polygon.inners()) {
+        if(GeometryError error = check_ring(inner, false);
+           error != GeometryError::none)
+            return error;
+        for(const auto & p : inner)
+            if(!boost::geometry::covered_by(Point2D(p.x(), p.y()), outer_box))
+                return GeometryError::interior_rings_outside;
+    }
+    return GeometryError::none;
+}
+
+template <typename MultiPolygon>
+GeometryError fast_check_multipolygon(const MultiPolygon & mp) noexcept {
+    for(const auto & polygon : mp)
+        if(GeometryError error = fast_check_polygon(polygon);
+           error != GeometryError::none)
+            return error;
+    return GeometryError::none;
+}
+
+/**
+ * Repairs a multipolygon with self-intersecting, badly oriented or
+ * overlapping rings. The rings are split at their self crossings, the
+ * pieces of the outer rings are merged and the pieces of the inner rings
+ * are removed from them.
+ */
+template <typename MultiPolygon>
+MultiPolygon repair_multipolygon(const MultiPolygon & mp) {
+    using Polygon = typename boost::range_value<MultiPolygon>::type;
+    auto as_multipolygon = [](const auto & ring) {
+        MultiPolygon piece;
+        piece.emplace_back().outer().assign(ring.begin(), ring.end());
+        boost::geometry::correct(piece);
+        return piece;
+    };
+    MultiPolygon repaired;
+    for(const Polygon & polygon : mp) {
+        MultiPolygon repaired_polygon;
+        for(const auto & loop : detail::split_ring(polygon.outer())) {
+            MultiPolygon merged;
+            boost::geometry::union_(repaired_polygon, as_multipolygon(loop),
+                                    merged);
+            repaired_polygon = std::move(merged);
+        }
+        for(const auto & inner : polygon.inners()) {
+            for(const auto & loop : detail::split_ring(inner)) {
+                MultiPolygon difference;
+                boost::geometry::difference(repaired_polygon,
+                                            as_multipolygon(loop), difference);
+                repaired_polygon = std::move(difference);
+            }
+        }
+        MultiPolygon merged;
+        boost::geometry::union_(repaired, repaired_polygon, merged);
+        repaired = std::move(merged);
+    }
+    return repaired;
+}
+
+#endif  // BG_VALIDATION_HPP
@@ -1,6 +1,9 @@
 #ifndef BUILDERS_HPP
 #define BUILDERS_HPP
 
+#include <memory>
+#include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -9,12 +12,39 @@
 
 #include "data_types/area.hpp"
 #include "data_types/node.hpp"
+#include "data_types/properties.hpp"
 #include "data_types/way.hpp"
 
+/**
+ * @brief Interns the exported properties of a rule, sorted by key, to be
+ * shared by all its features.
+ */
+inline std::shared_ptr<const Properties::Exported> intern_properties(
+    const std::vector<std::pair<std::string, std::string>> & properties) {
+    auto exported = std::make_shared<Properties::Exported>();
+    for(const auto & [key, value] : properties)
+        exported->emplace_back(detail::intern(key), detail::intern(value));
+    boost::sort(*exported);
+    return exported;
+}
+
+// interns the keys of the tags to forward, sorted
+inline std::vector<std::string_view> intern_keys(
+    const std::vector<std::string> & keys) {
+    std::vector<std::string_view> interned;
+    for(const std::string & key : keys)
+        interned.push_back(detail::intern(key));
+    boost::sort(interned);
+    return interned;
+}
+
 template <typename Tags>
-std::vector<std::pair<std::string, std::string>> forward_properties(
-    Tags && tags, const std::vector<std::string> & tags_to_forward) {
-    std::vector<std::pair<std::string, std::string>> forwarded_properties;
+Properties forward_properties(
+    const Tags & tags, const std::vector<std::string_view> & tags_to_forward,
+    const std::shared_ptr<const Properties::Exported> & properties_to_export) {
+    // reused by the features built by the thread
+    thread_local std::vector<Properties::value_type> forwarded_properties;
+    forwarded_properties.clear();
     auto tags_first = tags.cbegin();
     auto tags_last = tags.cend();
     auto tags_to_forward_first = tags_to_forward.cbegin();
@@ -30,81 +60,117 @@ std::vector<std::pair<std::string, std::string>> forward_properties(
             ++tags_to_forward_first;
             continue;
         }
-        forwarded_properties.emplace_back(*tags_first);
+        // the interned key, the value being copied in the arena
+        forwarded_properties.emplace_back(*tags_to_forward_first,
+                                          tags_first->second);
         ++tags_first;
         ++tags_to_forward_first;
     }
-    return forwarded_properties;
+    return Properties(forwarded_properties, properties_to_export);
 }
 
 class NodeBuilder {
 private:
-    std::vector<std::pair<std::string, std::string>> properties_to_export;
-    std::vector<std::string> tags_to_forward;
+    std::shared_ptr<const Properties::Exported> properties_to_export;
+    std::vector<std::string_view> tags_to_forward;
+    // width in meters of the polygon built around the geometry, 0 for none
+    float inflated_width;
 
 public:
-    template <typename EProperties, typename FProperties>
-    NodeBuilder(EProperties && properties, FProperties && tags_to_forward)
-        : properties_to_export(std::forward<EProperties>(properties))
-        , tags_to_forward(std::forward<FProperties>(tags_to_forward)) {
-        boost::sort(properties);
-        boost::sort(tags_to_forward);
-    }
+    NodeBuilder(
+        const std::vector<std::pair<std::string, std::string>> & properties,
+        const std::vector<std::string> & tags_to_forward,
+        float inflated_width = 0)
+        : properties_to_export(intern_properties(properties))
+        , tags_to_forward(intern_keys(tags_to_forward))
+        , inflated_width(inflated_width) {}
 
     template <typename Tags, typename Point>
     Node build(Tags && tags, Point && p) const {
-        std::vector<std::pair<std::string, std::string>> build_properties =
-            forward_properties(std::forward<Tags>(tags), tags_to_forward);
-        boost::copy(properties_to_export, std::back_inserter(build_properties));
-        return Node(std::forward<Point>(p), std::move(build_properties));
+        return Node(std::forward<Point>(p),
+                    forward_properties(tags, tags_to_forward,
+                                       properties_to_export));
+    }
+
+    bool isInflated() const noexcept { return inflated_width > 0; }
+    float getInflatedWidth() const noexcept { return inflated_width; }
+
+    /**
+     * Builds the area of the inflated geometry, with the same properties.
+     */
+    template <typename Tags, typename Multipolygon>
+    Area buildInflated(Tags && tags, Multipolygon && mp) const {
+        return Area(std::forward<Multipolygon>(mp),
+                    forward_properties(tags, tags_to_forward,
+                                       properties_to_export));
     }
 };
 
 class WayBuilder {
 private:
-    std::vector<std::pair<std::string, std::string>> properties_to_export;
-    std::vector<std::string> tags_to_forward;
+    std::shared_ptr<const Properties::Exported> properties_to_export;
+    std::vector<std::string_view> tags_to_forward;
+    // width in meters of the polygon built around the geometry, 0 for none
+    float inflated_width;
+    // tolerance in meters of the simplification, negative for the global one
+    float simplify_tolerance;
 
 public:
-    template <typename EProperties, typename FProperties>
-    WayBuilder(EProperties && properties, FProperties && tags_to_forward)
-        : properties_to_export(std::forward<EProperties>(properties))
-        , tags_to_forward(std::forward<FProperties>(tags_to_forward)) {
-        boost::sort(properties_to_export);
-        boost::sort(tags_to_forward);
-    }
+    WayBuilder(
+        const std::vector<std::pair<std::string, std::string>> & properties,
+        const std::vector<std::string> & tags_to_forward,
+        float inflated_width = 0, float simplify_tolerance = -1)
+        : properties_to_export(intern_properties(properties))
+        , tags_to_forward(intern_keys(tags_to_forward))
+        , inflated_width(inflated_width)
+        , simplify_tolerance(simplify_tolerance) {}
 
     template <typename Tags, typename Linestring>
     Way build(Tags && tags, Linestring && l) const {
-        std::vector<std::pair<std::string, std::string>> build_properties =
-            forward_properties(std::forward<Tags>(tags), tags_to_forward);
-        boost::copy(properties_to_export, std::back_inserter(build_properties));
-        return Way(std::forward<Linestring>(l), std::move(build_properties));
+        return Way(std::forward<Linestring>(l),
+                   forward_properties(tags, tags_to_forward,
+                                      properties_to_export));
+    }
+
+    bool isInflated() const noexcept { return inflated_width > 0; }
+    float getInflatedWidth() const noexcept { return inflated_width; }
+    float getSimplifyTolerance() const noexcept { return simplify_tolerance; }
+
+    /**
+     * Builds the area of the inflated geometry, with the same properties.
+     */
+    template <typename Tags, typename Multipolygon>
+    Area buildInflated(Tags && tags, Multipolygon && mp) const {
+        return Area(std::forward<Multipolygon>(mp),
+                    forward_properties(tags, tags_to_forward,
+                                       properties_to_export));
     }
 };
 
 class AreaBuilder {
 private:
-    std::vector<std::pair<std::string, std::string>> properties_to_export;
-    std::vector<std::string> tags_to_forward;
+    std::shared_ptr<const Properties::Exported> properties_to_export;
+    std::vector<std::string_view> tags_to_forward;
+    // tolerance in meters of the simplification, negative for the global one
+    float simplify_tolerance;
 
 public:
-    template <typename EProperties, typename FProperties>
-    AreaBuilder(EProperties && properties, FProperties && tags_to_forward)
-        : properties_to_export(std::forward<EProperties>(properties))
-        , tags_to_forward(std::forward<FProperties>(tags_to_forward)) {
-        boost::sort(properties_to_export);
-        boost::sort(tags_to_forward);
-    }
+    AreaBuilder(
+        const std::vector<std::pair<std::string, std::string>> & properties,
+        const std::vector<std::string> & tags_to_forward,
+        float simplify_tolerance = -1)
+        : properties_to_export(intern_properties(properties))
+        , tags_to_forward(intern_keys(tags_to_forward))
+        , simplify_tolerance(simplify_tolerance) {}
 
     template <typename Tags, typename Multipolygon>
     Area build(Tags && tags, Multipolygon && mp) const {
-        std::vector<std::pair<std::string, std::string>> build_properties =
-            forward_properties(std::forward<Tags>(tags), tags_to_forward);
-        boost::copy(properties_to_export, std::back_inserter(build_properties));
         return Area(std::forward<Multipolygon>(mp),
-                    std::move(build_properties));
+                    forward_properties(tags, tags_to_forward,
+                                       properties_to_export));
     }
+
+    float getSimplifyTolerance() const noexcept { return simplify_tolerance; }
 };
 
 #endif  // REGION_BUILDERS_HPP
\ No newline at end of file
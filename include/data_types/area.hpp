@@ -1,30 +1,28 @@
 #ifndef AREA_HPP
 #define AREA_HPP
 
-#include <list>
+#include <string_view>
 #include <utility>
-#include <vector>
 
 #include "bg_types.hpp"
+#include "data_types/properties.hpp"
 
 class Area {
 public:
-    const MultipolygonGeo multipolygon;
-    const std::vector<std::pair<std::string, std::string>> properties;
+    MultipolygonFixed multipolygon;
+    Properties properties;
 
-    template <typename Multipolygon, typename Properties>
-    Area(Multipolygon && multipolygon, Properties && properties)
-        : multipolygon(std::forward<Multipolygon>(multipolygon))
-        , properties(std::forward<Properties>(properties)) {}
+    template <typename Multipolygon, typename FeatureProperties>
+    Area(Multipolygon && multipolygon, FeatureProperties && properties)
+        : multipolygon(convert_geometry<MultipolygonFixed>(
+              std::forward<Multipolygon>(multipolygon)))
+        , properties(std::forward<FeatureProperties>(properties)) {}
 
-    bool hasProperty(const std::string & tag) const noexcept {
-        return std::any_of(properties.cbegin(), properties.cend(),
-                           [&tag](auto & p) { return p.first == tag; });
+    bool hasProperty(std::string_view key) const noexcept {
+        return properties.find(key) != properties.end();
     }
-    const std::string & getProperty(const std::string & tag) const noexcept {
-        return std::find_if(properties.cbegin(), properties.cend(),
-                            [&tag](auto & p) { return p.first == tag; })
-            ->second;
+    std::string_view getProperty(std::string_view key) const noexcept {
+        return properties.find(key)->second;
     }
 };
 
@@ -1,30 +1,27 @@
 #ifndef NODE_HPP
 #define NODE_HPP
 
-#include <list>
+#include <string_view>
 #include <utility>
-#include <vector>
 
 #include "bg_types.hpp"
+#include "data_types/properties.hpp"
 
 class Node {
 public:
-    const PointGeo point;
-    const std::vector<std::pair<std::string, std::string>> properties;
+    PointFixed point;
+    Properties properties;
 
-    template <typename Point, typename Properties>
-    Node(Point && point, Properties && properties)
-        : point(std::forward<Point>(point))
-        , properties(std::forward<Properties>(properties)) {}
+    template <typename Point, typename FeatureProperties>
+    Node(Point && point, FeatureProperties && properties)
+        : point(convert_geometry<PointFixed>(std::forward<Point>(point)))
+        , properties(std::forward<FeatureProperties>(properties)) {}
 
-    bool hasProperty(const std::string & tag) const noexcept {
-        return std::any_of(properties.cbegin(), properties.cend(),
-                           [&tag](auto & p) { return p.first == tag; });
+    bool hasProperty(std::string_view key) const noexcept {
+        return properties.find(key) != properties.end();
     }
-    const std::string & getProperty(const std::string & tag) const noexcept {
-        return std::find_if(properties.cbegin(), properties.cend(),
-                            [&tag](auto & p) { return p.first == tag; })
-            ->second;
+    std::string_view getProperty(std::string_view key) const noexcept {
+        return properties.find(key)->second;
     }
 };
 
@@ -0,0 +1,200 @@
+#ifndef PROPERTIES_HPP
+#define PROPERTIES_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace detail {
+/**
+ * @brief Returns the copy of s in a process wide pool, never freed, so that
+ * the rules keys and values are stored once whatever the number of features.
+ */
+inline std::string_view intern(std::string_view s) {
+    static std::mutex mutex;
+    // the nodes, and thus the strings, do not move on rehash
+    static std::unordered_set<std::string> pool;
+    std::lock_guard<std::mutex> lock(mutex);
+    return *pool.emplace(s).first;
+}
+
+/**
+ * @brief Bump allocator carving the properties of the features in large
+ * chunks, each one freed once the last properties it holds are.
+ */
+class PropertiesArena {
+private:
+    static constexpr std::size_t chunk_size = 64 << 10;
+    static constexpr std::size_t alignment = alignof(std::string_view);
+
+    std::shared_ptr<char[]> chunk;
+    std::size_t used = chunk_size;
+
+public:
+    // returns n bytes, aligned for string_views, and the chunk holding them
+    std::pair<char *, std::shared_ptr<const char[]>> allocate(std::size_t n) {
+        n = (n + alignment - 1) / alignment * alignment;
+        if(n > chunk_size / 4) {
+            std::shared_ptr<char[]> large(new char[n]);
+            return {large.get(), std::move(large)};
+        }
+        if(used + n > chunk_size) {
+            chunk.reset(new char[chunk_size]);
+            used = 0;
+        }
+        char * bytes = chunk.get() + used;
+        used += n;
+        return {bytes, chunk};
+    }
+};
+}  // namespace detail
+
+/**
+ * @brief Properties of a feature: its forwarded tags, stored in an arena
+ * chunk, followed by the exported properties of its rule, shared by all the
+ * features of the rule. Copies are shallow and the properties immutable.
+ */
+class Properties {
+public:
+    using value_type = std::pair<std::string_view, std::string_view>;
+    using Exported = std::vector<value_type>;
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Properties::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type *;
+        using reference = const value_type &;
+
+    private:
+        const value_type * current;
+        const value_type * forwarded_end;
+        const value_type * exported_first;
+
+    public:
+        const_iterator(const value_type * p_current,
+                       const value_type * p_forwarded_end,
+                       const value_type * p_exported_first) noexcept
+            : current(p_current)
+            , forwarded_end(p_forwarded_end)
+            , exported_first(p_exported_first) {}
+
+        reference operator*() const noexcept { return *current; }
+        pointer operator->() const noexcept { return current; }
+        const_iterator & operator++() noexcept {
+            if(++current == forwarded_end) current = exported_first;
+            return *this;
+        }
+        const_iterator operator++(int) noexcept {
+            const_iterator it = *this;
+            ++*this;
+            return it;
+        }
+        bool operator==(const const_iterator & other) const noexcept {
+            return current == other.current;
+        }
+        bool operator!=(const const_iterator & other) const noexcept {
+            return current != other.current;
+        }
+    };
+    using iterator = const_iterator;
+
+private:
+    std::shared_ptr<const char[]> chunk;
+    const value_type * forwarded;
+    std::size_t nb_forwarded;
+    std::shared_ptr<const Exported> exported;
+
+    static detail::PropertiesArena & arena() {
+        thread_local detail::PropertiesArena thread_arena;
+        return thread_arena;
+    }
+
+    // copies the views then the values, and the keys if asked, in the arena
+    template <typename Iterator>
+    void copy(Iterator first, Iterator last, bool copy_keys) {
+        nb_forwarded = static_cast<std::size_t>(std::distance(first, last));
+        if(nb_forwarded == 0) return;
+        std::size_t size = nb_forwarded * sizeof(value_type);
+        for(Iterator it = first; it != last; ++it)
+            size += (copy_keys ? it->first.size() : 0) + it->second.size();
+        auto [bytes, bytes_chunk] = arena().allocate(size);
+        chunk = std::move(bytes_chunk);
+        auto * views = reinterpret_cast<value_type *>(bytes);
+        char * strings = bytes + nb_forwarded * sizeof(value_type);
+        auto store = [&strings](std::string_view s) {
+            std::memcpy(strings, s.data(), s.size());
+            strings += s.size();
+            return std::string_view(strings - s.size(), s.size());
+        };
+        for(value_type * view = views; first != last; ++first, ++view) {
+            const std::string_view key(first->first);
+            new(view) value_type(copy_keys ? store(key) : key,
+                                 store(first->second));
+        }
+        forwarded = views;
+    }
+
+    const value_type * exported_begin() const noexcept {
+        return exported ? exported->data() : nullptr;
+    }
+    const value_type * exported_end() const noexcept {
+        return exported ? exported->data() + exported->size() : nullptr;
+    }
+
+public:
+    Properties() noexcept : forwarded(nullptr), nb_forwarded(0) {}
+
+    /**
+     * Copies the values of the forwarded properties in the arena of the
+     * thread, their keys must outlive the properties as the interned ones do.
+     */
+    Properties(const std::vector<value_type> & forwarded_properties,
+               std::shared_ptr<const Exported> exported_properties)
+        : forwarded(nullptr)
+        , nb_forwarded(0)
+        , exported(std::move(exported_properties)) {
+        copy(forwarded_properties.cbegin(), forwarded_properties.cend(),
+             false);
+    }
+
+    // copies the keys and values of the given properties
+    explicit Properties(
+        const std::vector<std::pair<std::string, std::string>> & properties)
+        : forwarded(nullptr), nb_forwarded(0) {
+        copy(properties.cbegin(), properties.cend(), true);
+    }
+
+    const_iterator begin() const noexcept {
+        if(nb_forwarded == 0)
+            return const_iterator(exported_begin(), nullptr, nullptr);
+        return const_iterator(forwarded, forwarded + nb_forwarded,
+                              exported_begin());
+    }
+    const_iterator end() const noexcept {
+        return const_iterator(exported_end(), nullptr, nullptr);
+    }
+
+    std::size_t size() const noexcept {
+        return nb_forwarded + (exported ? exported->size() : 0);
+    }
+    bool empty() const noexcept { return size() == 0; }
+
+    const_iterator find(std::string_view key) const noexcept {
+        return std::find_if(begin(), end(), [key](const value_type & p) {
+            return p.first == key;
+        });
+    }
+};
+
+#endif  // PROPERTIES_HPP
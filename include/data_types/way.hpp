@@ -1,30 +1,28 @@
 #ifndef WAY_HPP
 #define WAY_HPP
 
-#include <list>
+#include <string_view>
 #include <utility>
-#include <vector>
 
 #include "bg_types.hpp"
+#include "data_types/properties.hpp"
 
 class Way {
 public:
-    const LinestringGeo linestring;
-    const std::vector<std::pair<std::string, std::string>> properties;
+    LinestringFixed linestring;
+    Properties properties;
 
-    template <typename Linestring, typename Properties>
-    Way(Linestring && linestring, Properties && properties)
-        : linestring(std::forward<Linestring>(linestring))
-        , properties(std::forward<Properties>(properties)) {}
+    template <typename Linestring, typename FeatureProperties>
+    Way(Linestring && linestring, FeatureProperties && properties)
+        : linestring(convert_geometry<LinestringFixed>(
+              std::forward<Linestring>(linestring)))
+        , properties(std::forward<FeatureProperties>(properties)) {}
 
-    bool hasProperty(const std::string & tag) const noexcept {
-        return std::any_of(properties.cbegin(), properties.cend(),
-                           [&tag](auto & p) { return p.first == tag; });
+    bool hasProperty(std::string_view key) const noexcept {
+        return properties.find(key) != properties.end();
     }
-    const std::string & getProperty(const std::string & tag) const noexcept {
-        return std::find_if(properties.cbegin(), properties.cend(),
-                            [&tag](auto & p) { return p.first == tag; })
-            ->second;
+    std::string_view getProperty(std::string_view key) const noexcept {
+        return properties.find(key)->second;
     }
 };
 
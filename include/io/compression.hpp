@@ -0,0 +1,66 @@
+#ifndef COMPRESSION_HPP
+#define COMPRESSION_HPP
+
+#include <cstddef>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace IO {
+/**
+ * @brief Compression of the written files. Each block of data is compressed
+ * independently, as a gzip member or a zstd frame, so that the writing
+ * threads compress their blocks in parallel and the concatenated blocks
+ * form a standard stream that gzip or zstd decompress.
+ */
+enum class Compression { none, gzip, zstd };
+
+inline Compression compression_from_string(const std::string & name) {
+    if(name == "none") return Compression::none;
+    if(name == "gzip") return Compression::gzip;
+    if(name == "zstd") return Compression::zstd;
+    throw std::invalid_argument("unknown compression " + name);
+}
+
+inline const char * compression_name(Compression compression) {
+    switch(compression) {
+        case Compression::gzip:
+            return "gzip";
+        case Compression::zstd:
+            return "zstd";
+        default:
+            return "none";
+    }
+}
+
+inline const char * compression_extension(Compression compression) {
+    switch(compression) {
+        case Compression::gzip:
+            return ".gz";
+        case Compression::zstd:
+            return ".zst";
+        default:
+            return "";
+    }
+}
+
+// appends the extension of the compression to the file name if missing
+inline std::filesystem::path compressed_path(std::filesystem::path file,
+                                             Compression compression) {
+    const std::string extension = compression_extension(compression);
+    if(!extension.empty() && file.extension() != extension)
+        file += extension;
+    return file;
+}
+
+/**
+ * Replaces the content of out by the compressed block, a complete gzip
+ * member or zstd frame.
+ */
+void compress_block(Compression compression, std::string_view block,
+                    std::vector<char> & out);
+}  // namespace IO
+
+#endif  // COMPRESSION_HPP
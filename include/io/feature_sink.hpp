@@ -0,0 +1,27 @@
+#ifndef FEATURE_SINK_HPP
+#define FEATURE_SINK_HPP
+
+#include "data_types/area.hpp"
+#include "data_types/node.hpp"
+#include "data_types/way.hpp"
+
+namespace IO {
+/**
+ * @brief Receives the features as soon as they are matched, to write them
+ * without accumulating the whole result in memory.
+ *
+ * The write methods may be called concurrently from the query threads.
+ */
+class FeatureSink {
+public:
+    virtual ~FeatureSink() = default;
+
+    virtual void write(const Node & node) = 0;
+    virtual void write(const Way & way) = 0;
+    virtual void write(const Area & area) = 0;
+
+    virtual void close() = 0;
+};
+}  // namespace IO
+
+#endif  // FEATURE_SINK_HPP
@@ -0,0 +1,227 @@
+#ifndef FLATGEOBUF_WRITER_HPP
+#define FLATGEOBUF_WRITER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <tbb/enumerable_thread_specific.h>
+
+#include "bg_types.hpp"
+#include "io/feature_sink.hpp"
+
+namespace IO {
+namespace detail {
+/**
+ * @brief Writes flatbuffers tables front to back, the objects referenced by
+ * a table are written after it and its offsets patched when they are.
+ *
+ * Only the subset of flatbuffers needed by the FlatGeobuf schema is
+ * supported and the host is assumed to be little endian.
+ */
+class FlatBufferBuilder {
+private:
+    std::vector<std::uint8_t> & buffer;
+    std::size_t base;
+    std::size_t vtable;
+    std::size_t table;
+
+public:
+    // starts a size prefixed buffer at the end of the given one
+    explicit FlatBufferBuilder(std::vector<std::uint8_t> & p_buffer)
+        : buffer(p_buffer), base(p_buffer.size()), vtable(0), table(0) {
+        scalar<std::uint32_t>(0);  // size prefix
+        scalar<std::uint32_t>(0);  // root table offset
+    }
+
+    std::size_t position() const noexcept { return buffer.size() - base; }
+
+    // pads until position() + offset is a multiple of the alignment
+    void pad(std::size_t alignment, std::size_t offset = 0) {
+        while((position() + offset) % alignment != 0) buffer.push_back(0);
+    }
+
+    template <typename T>
+    std::size_t scalar(T value) {
+        pad(sizeof(T));
+        const std::size_t pos = position();
+        const auto * bytes = reinterpret_cast<const std::uint8_t *>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+        return pos;
+    }
+
+    template <typename T>
+    void patch(std::size_t pos, T value) noexcept {
+        std::memcpy(buffer.data() + base + pos, &value, sizeof(T));
+    }
+
+    // points the offset at offset_pos to the current position
+    void link(std::size_t offset_pos) noexcept {
+        patch(offset_pos, static_cast<std::uint32_t>(position() - offset_pos));
+    }
+
+    /**
+     * Starts the table referenced by the offset at offset_pos, its fields
+     * must be added before any other object.
+     */
+    void startTable(std::size_t offset_pos, std::uint16_t nb_fields) {
+        pad(2);
+        vtable = position();
+        scalar<std::uint16_t>(static_cast<std::uint16_t>(4 + 2 * nb_fields));
+        for(std::uint16_t i = 0; i <= nb_fields; ++i)
+            scalar<std::uint16_t>(0);
+        pad(8);
+        table = position();
+        link(offset_pos);
+        scalar<std::int32_t>(static_cast<std::int32_t>(table - vtable));
+    }
+    void startRoot(std::uint16_t nb_fields) { startTable(4, nb_fields); }
+
+    template <typename T>
+    void field(std::uint16_t id, T value) {
+        const std::size_t pos = scalar(value);
+        patch(vtable + 4 + 2 * id, static_cast<std::uint16_t>(pos - table));
+    }
+    // returns the position of the offset to patch with link()
+    std::size_t offsetField(std::uint16_t id) {
+        const std::size_t pos = scalar<std::uint32_t>(0);
+        patch(vtable + 4 + 2 * id, static_cast<std::uint16_t>(pos - table));
+        return pos;
+    }
+    void endTable() noexcept {
+        patch(vtable + 2, static_cast<std::uint16_t>(position() - table));
+    }
+
+    void string(std::size_t offset_pos, std::string_view s) {
+        pad(4);
+        link(offset_pos);
+        scalar(static_cast<std::uint32_t>(s.size()));
+        buffer.insert(buffer.end(), s.begin(), s.end());
+        buffer.push_back(0);
+    }
+
+    template <typename T>
+    void vector(std::size_t offset_pos, const T * values, std::size_t n) {
+        pad(std::max(sizeof(T), std::size_t{4}), 4);
+        link(offset_pos);
+        scalar(static_cast<std::uint32_t>(n));
+        const auto * bytes = reinterpret_cast<const std::uint8_t *>(values);
+        buffer.insert(buffer.end(), bytes, bytes + n * sizeof(T));
+    }
+
+    // returns the position of the first of the n offsets to the tables
+    std::size_t tablesVector(std::size_t offset_pos, std::size_t n) {
+        pad(4);
+        link(offset_pos);
+        scalar(static_cast<std::uint32_t>(n));
+        const std::size_t first = position();
+        buffer.resize(buffer.size() + 4 * n, 0);
+        return first;
+    }
+
+    // pads the buffer to 8 bytes and writes its size prefix
+    void finish() {
+        pad(8);
+        patch(0, static_cast<std::uint32_t>(position() - 4));
+    }
+};
+
+// position of the point (x,y) of the 2^16 x 2^16 grid along the Hilbert curve
+std::uint32_t hilbert(std::uint32_t x, std::uint32_t y) noexcept;
+}  // namespace detail
+
+/**
+ * @brief Streams features to a FlatGeobuf file with a packed Hilbert R-tree
+ * index, allowing bounding box reads without parsing the whole file.
+ *
+ * The features are encoded by each writing thread into its own buffer,
+ * which is appended to a temporary file once it exceeds the buffer size.
+ * Since the index orders the features by the Hilbert value of their
+ * bounding box center, and the header lists every property as a string
+ * column, the file is written on close from the temporary one.
+ */
+class FlatGeobufWriter : public FeatureSink {
+private:
+    // position of an encoded feature in the temporary file
+    struct Entry {
+        double min_x, min_y, max_x, max_y;
+        std::uint64_t offset;
+        std::uint32_t size;
+    };
+    struct LocalBuffer {
+        std::vector<std::uint8_t> bytes;
+        std::vector<Entry> entries;
+        // column indices keyed by views of the writer column names
+        std::unordered_map<std::string_view, std::uint16_t> columns;
+        // properties vector of the feature being encoded
+        std::vector<std::uint8_t> properties;
+    };
+
+    std::filesystem::path path;
+    std::filesystem::path features_path;
+    std::size_t buffer_size;
+    std::uint64_t features_size;
+    bool closed;
+    std::mutex mutex;
+    std::vector<Entry> entries;
+    // a deque so that the views of the names stay valid when one is added
+    std::deque<std::string> column_names;
+    std::unordered_map<std::string_view, std::uint16_t> columns;
+    tbb::enumerable_thread_specific<LocalBuffer> buffers;
+
+    std::uint16_t column(LocalBuffer & buffer, std::string_view name);
+    void encodeProperties(LocalBuffer & buffer,
+                          detail::FlatBufferBuilder & builder,
+                          std::size_t offset_pos,
+                          const Properties & properties);
+    void flush(LocalBuffer & buffer);
+
+    template <typename Feature, typename Encode>
+    void encode(const Feature & feature, const Box2D & box,
+                Encode && encode_geometry) {
+        LocalBuffer & buffer = buffers.local();
+        const std::size_t start = buffer.bytes.size();
+        detail::FlatBufferBuilder builder(buffer.bytes);
+        // Feature table: geometry, properties
+        builder.startRoot(2);
+        const std::size_t geometry_pos = builder.offsetField(0);
+        const std::size_t properties_pos =
+            feature.properties.empty() ? 0 : builder.offsetField(1);
+        builder.endTable();
+        encode_geometry(builder, geometry_pos);
+        if(!feature.properties.empty())
+            encodeProperties(buffer, builder, properties_pos,
+                             feature.properties);
+        builder.finish();
+        buffer.entries.push_back(
+            {box.min_corner().x(), box.min_corner().y(), box.max_corner().x(),
+             box.max_corner().y(), start,
+             static_cast<std::uint32_t>(buffer.bytes.size() - start)});
+        if(buffer.bytes.size() >= buffer_size) flush(buffer);
+    }
+
+public:
+    /**
+     * @param buffer_size The number of bytes buffered by each thread.
+     */
+    explicit FlatGeobufWriter(const std::filesystem::path & fgb_file,
+                              std::size_t buffer_size = 1 << 20);
+    ~FlatGeobufWriter();
+
+    void write(const Node & node) override;
+    void write(const Way & way) override;
+    void write(const Area & area) override;
+
+    void close() override;
+};
+}  // namespace IO
+
+#endif  // FLATGEOBUF_WRITER_HPP
@@ -0,0 +1,192 @@
+#ifndef GEOJSON_SERIALIZER_HPP
+#define GEOJSON_SERIALIZER_HPP
+
+#include <charconv>
+#include <cstring>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "bg_types.hpp"
+#include "data_types/area.hpp"
+#include "data_types/node.hpp"
+#include "data_types/way.hpp"
+
+namespace IO {
+/**
+ * @brief Serializes features as GeoJSON into a reusable char buffer.
+ *
+ * Coordinates are printed with the shortest representation that round-trips
+ * or, if a precision is given, rounded to at most that many decimals. Each
+ * feature is preceded by a ',' separator that the caller drops for the first
+ * feature of the collection.
+ */
+class GeoJSONSerializer {
+private:
+    std::vector<char> data;
+    std::size_t length;
+    int precision;
+
+    char * grow(std::size_t n) {
+        if(length + n > data.size())
+            data.resize(std::max(2 * data.size(), length + n));
+        return data.data() + length;
+    }
+
+    void append(std::string_view s) {
+        std::memcpy(grow(s.size()), s.data(), s.size());
+        length += s.size();
+    }
+    void append(char c) {
+        *grow(1) = c;
+        ++length;
+    }
+
+    void append_double(double d) {
+        constexpr std::size_t max_double_chars = 32;
+        char * first = grow(max_double_chars);
+        char * last = first + max_double_chars;
+        std::to_chars_result result{first, std::errc::value_too_large};
+        if(precision >= 0) {
+            result = std::to_chars(first, last, d, std::chars_format::fixed,
+                                   precision);
+            // drop the trailing zeros of the decimals
+            if(result.ec == std::errc{} && precision > 0) {
+                while(result.ptr[-1] == '0') --result.ptr;
+                if(result.ptr[-1] == '.') --result.ptr;
+            }
+        }
+        // the values too large for the fixed format are printed in the
+        // shortest representation, which always fits
+        if(result.ec != std::errc{}) result = std::to_chars(first, last, d);
+        length += static_cast<std::size_t>(result.ptr - first);
+    }
+
+    void append_escaped(std::string_view s) {
+        static constexpr char hex[] = "0123456789abcdef";
+        append('"');
+        std::size_t run_begin = 0;
+        for(std::size_t i = 0; i < s.size(); ++i) {
+            const unsigned char c = static_cast<unsigned char>(s[i]);
+            if(c >= 0x20 && c != '"' && c != '\\') continue;
+            append(s.substr(run_begin, i - run_begin));
+            run_begin = i + 1;
+            switch(c) {
+                case '"':
+                    append("\\\"");
+                    break;
+                case '\\':
+                    append("\\\\");
+                    break;
+                case '\b':
+                    append("\\b");
+                    break;
+                case '\f':
+                    append("\\f");
+                    break;
+                case '\n':
+                    append("\\n");
+                    break;
+                case '\r':
+                    append("\\r");
+                    break;
+                case '\t':
+                    append("\\t");
+                    break;
+                default:
+                    append("\\u00");
+                    append(hex[c >> 4]);
+                    append(hex[c & 0xf]);
+            }
+        }
+        append(s.substr(run_begin));
+        append('"');
+    }
+
+    template <typename Point>
+    void append_point(const Point & p) {
+        append('[');
+        append_double(boost::geometry::get<0>(p));
+        append(',');
+        append_double(boost::geometry::get<1>(p));
+        append(']');
+    }
+
+    template <typename Range>
+    void append_points(const Range & points) {
+        append('[');
+        bool first = true;
+        for(const auto & p : points) {
+            if(!first) append(',');
+            first = false;
+            append_point(p);
+        }
+        append(']');
+    }
+
+    template <typename Polygon>
+    void append_polygon(const Polygon & polygon) {
+        append('[');
+        append_points(polygon.outer());
+        for(const auto & ring : polygon.inners()) {
+            append(',');
+            append_points(ring);
+        }
+        append(']');
+    }
+
+    template <typename Properties>
+    void append_properties(const Properties & properties) {
+        append("},\"properties\":{");
+        bool first = true;
+        for(const auto & [key, value] : properties) {
+            if(!first) append(',');
+            first = false;
+            append_escaped(key);
+            append(':');
+            append_escaped(value);
+        }
+        append("}}");
+    }
+
+public:
+    // the buffer doubles when needed from its initial capacity
+    explicit GeoJSONSerializer(int p_precision = -1,
+                               std::size_t initial_capacity = 4 << 10)
+        : data(initial_capacity), length(0), precision(p_precision) {}
+
+    const char * buffer() const noexcept { return data.data(); }
+    std::size_t size() const noexcept { return length; }
+    bool empty() const noexcept { return length == 0; }
+    void clear() noexcept { length = 0; }
+
+    void serialize(const Node & node) {
+        append(",{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\","
+               "\"coordinates\":");
+        append_point(node.point);
+        append_properties(node.properties);
+    }
+
+    void serialize(const Way & way) {
+        append(",{\"type\":\"Feature\",\"geometry\":{\"type\":\"LineString\","
+               "\"coordinates\":");
+        append_points(way.linestring);
+        append_properties(way.properties);
+    }
+
+    void serialize(const Area & area) {
+        append(",{\"type\":\"Feature\",\"geometry\":{\"type\":\"MultiPolygon\","
+               "\"coordinates\":[");
+        bool first = true;
+        for(const auto & polygon : area.multipolygon) {
+            if(!first) append(',');
+            first = false;
+            append_polygon(polygon);
+        }
+        append(']');
+        append_properties(area.properties);
+    }
+};
+}  // namespace IO
+
+#endif  // GEOJSON_SERIALIZER_HPP
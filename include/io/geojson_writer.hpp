@@ -0,0 +1,73 @@
+#ifndef GEOJSON_WRITER_HPP
+#define GEOJSON_WRITER_HPP
+
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include <tbb/enumerable_thread_specific.h>
+
+#include "io/compression.hpp"
+#include "io/feature_sink.hpp"
+#include "io/geojson_serializer.hpp"
+
+namespace IO {
+/**
+ * @brief Streams features to a GeoJSON FeatureCollection file, the
+ * collection header is written at construction and its footer on close.
+ *
+ * Each writing thread serializes into its own buffer which is appended to
+ * the file once it exceeds the buffer size. The file is only opened to
+ * append the buffers, so that thousands of writers can coexist, as for the
+ * outputs of the regions.
+ *
+ * If compressed, each thread compresses its buffer before appending it, so
+ * the file is a sequence of gzip members or zstd frames.
+ */
+class GeoJSONWriter : public FeatureSink {
+private:
+    std::filesystem::path path;
+    std::size_t buffer_size;
+    bool empty;
+    bool closed;
+    Compression compression;
+    std::mutex mutex;
+    tbb::enumerable_thread_specific<GeoJSONSerializer> serializers;
+
+    std::ofstream open(std::ios::openmode mode);
+    std::string_view compress(std::string_view block,
+                              std::vector<char> & compressed) const;
+    void writeBlock(std::string_view block, std::ios::openmode mode);
+    void flush(GeoJSONSerializer & serializer);
+
+    template <typename Feature>
+    void serialize(const Feature & feature) {
+        GeoJSONSerializer & serializer = serializers.local();
+        serializer.serialize(feature);
+        if(serializer.size() >= buffer_size) flush(serializer);
+    }
+
+public:
+    /**
+     * @param precision The number of decimals of the coordinates, or -1 for
+     *                  the shortest representation that round-trips.
+     * @param buffer_size The number of bytes buffered by each thread.
+     * @param compression The compression of the file, whose name is kept.
+     */
+    explicit GeoJSONWriter(const std::filesystem::path & json_file,
+                           int precision = -1,
+                           std::size_t buffer_size = 1 << 20,
+                           Compression compression = Compression::none);
+    ~GeoJSONWriter();
+
+    void write(const Node & node) override { serialize(node); }
+    void write(const Way & way) override { serialize(way); }
+    void write(const Area & area) override { serialize(area); }
+
+    void close() override;
+};
+}  // namespace IO
+
+#endif  // GEOJSON_WRITER_HPP
@@ -0,0 +1,84 @@
+#ifndef MVT_WRITER_HPP
+#define MVT_WRITER_HPP
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <tbb/enumerable_thread_specific.h>
+
+#include <boost/geometry.hpp>
+
+#include "bg_types.hpp"
+#include "io/compression.hpp"
+#include "io/feature_sink.hpp"
+
+namespace IO {
+struct MVTOptions {
+    unsigned min_zoom = 0;
+    unsigned max_zoom = 14;
+    // number of threads building the tiles on close
+    unsigned nb_threads = 1;
+    // compression of each tile
+    Compression compression = Compression::none;
+};
+
+/**
+ * @brief Collects the features and writes them on close as a pyramid of
+ * Mapbox Vector Tiles, in <directory>/<z>/<x>/<y>.pbf files.
+ *
+ * The tiles are built in parallel from the zoom level 0 down, each one
+ * clipping to its bounds plus a buffer the parts of the features inside its
+ * parent tile, then simplifying them to the tile resolution. The areas
+ * covering a whole tile are drawn as its square without further clipping. The features form
+ * a single layer named after the directory, described with the zoom levels
+ * and the bounds in <directory>/metadata.json.
+ */
+class MVTWriter : public FeatureSink {
+public:
+    // number of units of the tile side and of the buffer around the tiles
+    static constexpr unsigned extent = 4096;
+    static constexpr unsigned buffer = 64;
+
+    // web mercator coordinates in [0,1], the y axis growing southward makes
+    // the clockwise outer rings counterclockwise, and clockwise on screen as
+    // MVT requires
+    using WorldPolygon = boost::geometry::model::polygon<Point2D, false>;
+    using WorldMultipolygon =
+        boost::geometry::model::multi_polygon<WorldPolygon>;
+
+    template <typename Geometry>
+    struct Feature {
+        Geometry geometry;
+        Box2D box;
+        Properties properties;
+    };
+    struct Features {
+        std::vector<Feature<Point2D>> points;
+        std::vector<Feature<Linestring2D>> lines;
+        std::vector<Feature<WorldMultipolygon>> areas;
+    };
+
+private:
+    std::filesystem::path directory;
+    std::string layer_name;
+    MVTOptions options;
+    bool closed;
+    tbb::enumerable_thread_specific<Features> features;
+
+    void writeMetadata(const Features & all) const;
+
+public:
+    explicit MVTWriter(const std::filesystem::path & tiles_directory,
+                       MVTOptions options = MVTOptions{});
+    ~MVTWriter();
+
+    void write(const Node & node) override;
+    void write(const Way & way) override;
+    void write(const Area & area) override;
+
+    void close() override;
+};
+}  // namespace IO
+
+#endif  // MVT_WRITER_HPP
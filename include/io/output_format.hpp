@@ -0,0 +1,87 @@
+#ifndef OUTPUT_FORMAT_HPP
+#define OUTPUT_FORMAT_HPP
+
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "io/compression.hpp"
+#include "io/feature_sink.hpp"
+#include "io/flatgeobuf_writer.hpp"
+#include "io/geojson_writer.hpp"
+#include "io/mvt_writer.hpp"
+
+namespace IO {
+/**
+ * @brief Format of the written features, auto chooses it from the
+ * extension of each output file. The mvt output is a tiles directory.
+ */
+enum class OutputFormat { automatic, geojson, flatgeobuf, mvt };
+
+inline OutputFormat output_format_from_string(const std::string & name) {
+    if(name == "auto") return OutputFormat::automatic;
+    if(name == "geojson") return OutputFormat::geojson;
+    if(name == "flatgeobuf") return OutputFormat::flatgeobuf;
+    if(name == "mvt") return OutputFormat::mvt;
+    throw std::invalid_argument("unknown output format " + name);
+}
+
+inline OutputFormat resolve_output_format(
+    OutputFormat format, const std::filesystem::path & file) {
+    if(format != OutputFormat::automatic) return format;
+    return file.extension() == ".fgb" ? OutputFormat::flatgeobuf
+                                      : OutputFormat::geojson;
+}
+
+inline const char * output_format_extension(OutputFormat format) {
+    switch(format) {
+        case OutputFormat::flatgeobuf:
+            return ".fgb";
+        case OutputFormat::mvt:
+            return "";
+        default:
+            return ".geojson";
+    }
+}
+
+struct OutputOptions {
+    OutputFormat format = OutputFormat::automatic;
+    // number of decimals of the GeoJSON coordinates, the FlatGeobuf ones
+    // being stored as doubles
+    int precision = -1;
+    // compression of the GeoJSON files and of the tiles
+    Compression compression = Compression::none;
+    MVTOptions mvt;
+};
+
+/**
+ * @brief Makes the writer of the given format, or of the format of the file
+ * extension. The compressed GeoJSON files get the compression extension.
+ *
+ * @param buffer_size The number of bytes buffered by each writing thread.
+ */
+inline std::shared_ptr<FeatureSink> make_feature_sink(
+    const std::filesystem::path & file, const OutputOptions & options,
+    std::size_t buffer_size = 1 << 20) {
+    switch(resolve_output_format(options.format, file)) {
+        case OutputFormat::flatgeobuf:
+            // the index reads need an uncompressed file
+            if(options.compression != Compression::none)
+                throw std::invalid_argument(
+                    "flatgeobuf output cannot be compressed");
+            return std::make_shared<FlatGeobufWriter>(file, buffer_size);
+        case OutputFormat::mvt: {
+            MVTOptions mvt = options.mvt;
+            mvt.compression = options.compression;
+            return std::make_shared<MVTWriter>(file, mvt);
+        }
+        default:
+            return std::make_shared<GeoJSONWriter>(
+                compressed_path(file, options.compression), options.precision,
+                buffer_size, options.compression);
+    }
+}
+}  // namespace IO
+
+#endif  // OUTPUT_FORMAT_HPP
@@ -19,6 +19,7 @@ namespace IO {
 void print_geojson(const std::vector<Node> & nodes,
                    const std::vector<Way> & ways,
                    const std::vector<Area> & areas,
-                   const std::filesystem::path & json_file);
+                   const std::filesystem::path & json_file,
+                   int precision = -1);
 }
 #endif  // PRINT_GEOJSON_HPP
\ No newline at end of file
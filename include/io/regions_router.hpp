@@ -0,0 +1,121 @@
+#ifndef REGIONS_ROUTER_HPP
+#define REGIONS_ROUTER_HPP
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/geometry.hpp>
+#include <boost/geometry/index/rtree.hpp>
+
+#include "bg_types.hpp"
+#include "io/feature_sink.hpp"
+#include "prepared_search_area.hpp"
+
+namespace IO {
+/**
+ * @brief Sends each feature to the sinks of all the regions it intersects.
+ *
+ * The candidate regions of a feature are found with an R-tree over the
+ * bounding boxes of the regions. If clipping, each region receives only the
+ * parts of the ways and areas inside it.
+ */
+class RegionsRouter : public FeatureSink {
+public:
+    struct Region {
+        std::string name;
+        std::shared_ptr<const PreparedSearchArea> area;
+        std::shared_ptr<FeatureSink> sink;
+    };
+
+private:
+    using RTree =
+        boost::geometry::index::rtree<std::pair<Box2D, std::size_t>,
+                                      boost::geometry::index::rstar<16>>;
+
+    std::vector<Region> regions;
+    RTree regions_rtree;
+    BoxGeo box;
+    bool clip;
+
+    static Box2D to_box2D(const BoxGeo & b) {
+        return Box2D(Point2D(b.min_corner().x(), b.min_corner().y()),
+                     Point2D(b.max_corner().x(), b.max_corner().y()));
+    }
+
+    static void write_clipped(const Region & region, const Node & node,
+                              const PointGeo &) {
+        region.sink->write(node);
+    }
+    static void write_clipped(const Region & region, const Way & way,
+                              const LinestringGeo & linestring) {
+        for(LinestringGeo & part : region.area->clip(linestring))
+            region.sink->write(Way(std::move(part), way.properties));
+    }
+    static void write_clipped(const Region & region, const Area & area,
+                              const MultipolygonGeo & multipolygon) {
+        MultipolygonGeo clipped = region.area->clip(multipolygon);
+        if(!clipped.empty())
+            region.sink->write(Area(std::move(clipped), area.properties));
+    }
+
+    /**
+     * The envelope is computed on the stored geometry, which is converted to
+     * the double coordinates of the area predicates only once a region box
+     * matches it.
+     */
+    template <typename GeometryGeo, typename Feature, typename Geometry>
+    void route(const Feature & feature, const Geometry & stored) {
+        const Box2D envelope =
+            to_box2D(boost::geometry::return_envelope<BoxGeo>(stored));
+        std::optional<GeometryGeo> geometry;
+        for(auto it = regions_rtree.qbegin(
+                boost::geometry::index::intersects(envelope));
+            it != regions_rtree.qend(); ++it) {
+            const Region & region = regions[it->second];
+            if(!geometry) geometry = convert_geometry<GeometryGeo>(stored);
+            if(!region.area->intersects(*geometry)) continue;
+            if(clip)
+                write_clipped(region, feature, *geometry);
+            else
+                region.sink->write(feature);
+        }
+    }
+
+public:
+    explicit RegionsRouter(std::vector<Region> p_regions, bool p_clip = false)
+        : regions(std::move(p_regions))
+        , box(boost::geometry::make_inverse<BoxGeo>())
+        , clip(p_clip) {
+        std::vector<std::pair<Box2D, std::size_t>> boxes;
+        for(std::size_t i = 0; i < regions.size(); ++i) {
+            const BoxGeo & region_box = regions[i].area->getBox();
+            boxes.emplace_back(to_box2D(region_box), i);
+            boost::geometry::expand(box, region_box);
+        }
+        regions_rtree = RTree(boxes);
+    }
+
+    const std::vector<Region> & getRegions() const noexcept { return regions; }
+    // box containing every region
+    const BoxGeo & getBox() const noexcept { return box; }
+
+    void write(const Node & node) override {
+        route<PointGeo>(node, node.point);
+    }
+    void write(const Way & way) override {
+        route<LinestringGeo>(way, way.linestring);
+    }
+    void write(const Area & area) override {
+        route<MultipolygonGeo>(area, area.multipolygon);
+    }
+
+    void close() override {
+        for(Region & region : regions) region.sink->close();
+    }
+};
+}  // namespace IO
+
+#endif  // REGIONS_ROUTER_HPP
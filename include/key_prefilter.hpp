@@ -0,0 +1,92 @@
+#ifndef KEY_PREFILTER_HPP
+#define KEY_PREFILTER_HPP
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Rejects, without allocating, the tag lists that contain none of the
+ * keys referenced by a set of rules.
+ *
+ * Keys are tested against a 256 bits bloom filter first, then against an
+ * open addressing table of the keys for the few bloom positives.
+ */
+class KeyPrefilter {
+private:
+    std::array<std::uint64_t, 4> bloom;
+    std::vector<std::pair<std::uint64_t, std::string>> table;
+    std::uint64_t table_mask;
+
+    static std::uint64_t hash(const char * key) noexcept {
+        std::uint64_t h = 14695981039346656037ull;  // FNV-1a
+        for(; *key != '\0'; ++key) {
+            h ^= static_cast<unsigned char>(*key);
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    bool bloom_test(std::uint64_t h) const noexcept {
+        const unsigned b1 = h & 0xff;
+        const unsigned b2 = (h >> 8) & 0xff;
+        return (bloom[b1 >> 6] >> (b1 & 63) & 1) &&
+               (bloom[b2 >> 6] >> (b2 & 63) & 1);
+    }
+
+    void insert(const std::string & key) {
+        const std::uint64_t h = hash(key.c_str());
+        const unsigned b1 = h & 0xff;
+        const unsigned b2 = (h >> 8) & 0xff;
+        bloom[b1 >> 6] |= std::uint64_t{1} << (b1 & 63);
+        bloom[b2 >> 6] |= std::uint64_t{1} << (b2 & 63);
+        for(std::uint64_t i = h & table_mask;; i = (i + 1) & table_mask) {
+            auto & [slot_hash, slot_key] = table[i];
+            if(slot_key.empty()) {
+                slot_hash = h;
+                slot_key = key;
+                return;
+            }
+            if(slot_key == key) return;
+        }
+    }
+
+public:
+    KeyPrefilter() : bloom{}, table(1), table_mask(0) {}
+
+    template <typename Keys>
+    explicit KeyPrefilter(const Keys & keys) : bloom{} {
+        std::size_t table_size = 1;
+        while(table_size < 2 * keys.size()) table_size *= 2;
+        table.resize(table_size);
+        table_mask = table_size - 1;
+        for(const std::string & key : keys)
+            if(!key.empty()) insert(key);
+    }
+
+    bool contains(const char * key) const noexcept {
+        const std::uint64_t h = hash(key);
+        if(!bloom_test(h)) return false;
+        for(std::uint64_t i = h & table_mask;; i = (i + 1) & table_mask) {
+            const auto & [slot_hash, slot_key] = table[i];
+            if(slot_key.empty()) return false;
+            if(slot_hash == h && std::strcmp(slot_key.c_str(), key) == 0)
+                return true;
+        }
+    }
+
+    /**
+     * Tests if at least one of the tags has a key of the prefilter.
+     */
+    template <typename Tags>
+    bool may_match(const Tags & tags) const noexcept {
+        for(const auto & tag : tags)
+            if(contains(tag.key())) return true;
+        return false;
+    }
+};
+
+#endif  // KEY_PREFILTER_HPP
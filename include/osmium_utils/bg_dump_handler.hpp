@@ -1,7 +1,10 @@
 #ifndef BG_DUMP_HANDLER_HPP
 #define BG_DUMP_HANDLER_HPP
 
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <memory>
 #include <utility>
 #include <vector>
 
@@ -11,40 +14,145 @@
 #include "osmium_utils/bg_factory.hpp"
 
 #include "bg_types.hpp"
+#include "bg_utils.hpp"
 #include "builders.hpp"
-
-#include <boost/log/trivial.hpp>
+#include "io/feature_sink.hpp"
+#include "prepared_search_area.hpp"
+#include "rules_index.hpp"
+#include "simplify.hpp"
 
 #include <iterator>
 
+/**
+ * @brief Number of discarded entities per geometry error, with the ids of
+ * the first ones as samples.
+ */
+class GeometryErrorReport {
+public:
+    // maximal number of sample ids kept per error
+    static constexpr std::size_t max_samples = 8;
+    // type of the sampled entity, 'n', 'w' or 'r', and its id
+    using Sample = std::pair<char, osmium::object_id_type>;
+
+private:
+    std::array<std::size_t, nb_geometry_errors> counts{};
+    std::array<std::vector<Sample>, nb_geometry_errors> samples;
+
+public:
+    void add(GeometryError error, char type, osmium::object_id_type id) {
+        const std::size_t e = static_cast<std::size_t>(error);
+        ++counts[e];
+        if(samples[e].size() < max_samples) samples[e].emplace_back(type, id);
+    }
+
+    std::size_t count(GeometryError error) const noexcept {
+        return counts[static_cast<std::size_t>(error)];
+    }
+    const std::vector<Sample> & getSamples(GeometryError error) const noexcept {
+        return samples[static_cast<std::size_t>(error)];
+    }
+    bool empty() const noexcept {
+        return std::all_of(counts.cbegin(), counts.cend(),
+                           [](std::size_t c) { return c == 0; });
+    }
+
+    GeometryErrorReport & operator+=(const GeometryErrorReport & other) {
+        for(std::size_t e = 0; e < nb_geometry_errors; ++e) {
+            counts[e] += other.counts[e];
+            for(const Sample & sample : other.samples[e]) {
+                if(samples[e].size() == max_samples) break;
+                samples[e].push_back(sample);
+            }
+        }
+        return *this;
+    }
+};
+
+inline std::ostream & operator<<(std::ostream & os,
+                                 const GeometryErrorReport & report) {
+    for(std::size_t e = 0; e < nb_geometry_errors; ++e) {
+        const GeometryError error = static_cast<GeometryError>(e);
+        if(report.count(error) == 0) continue;
+        os << "\n  " << geometry_error_name(error) << ": "
+           << report.count(error) << " (";
+        const char * separator = "";
+        for(const auto & [type, id] : report.getSamples(error)) {
+            os << separator << type << id;
+            separator = " ";
+        }
+        os << (report.count(error) > report.getSamples(error).size() ? " ...)"
+                                                                     : ")");
+    }
+    return os;
+}
+
+/**
+ * @brief Counters of the entities processed by a BGDumpHandler.
+ */
+struct BGDumpStats {
+    // entities rejected by the key prefilter, before sorting their tags
+    std::size_t prefiltered_nodes = 0;
+    std::size_t prefiltered_ways = 0;
+    std::size_t prefiltered_areas = 0;
+    // matched entities whose geometry could not be built or is invalid
+    std::size_t discarded_nodes = 0;
+    std::size_t discarded_ways = 0;
+    std::size_t discarded_areas = 0;
+    // invalid geometries repaired by the "repair" validation mode
+    std::size_t repaired_geometries = 0;
+    GeometryErrorReport errors;
+    // vertices of the simplified or rounded geometries, before and after
+    std::size_t input_vertices = 0;
+    std::size_t output_vertices = 0;
+
+    BGDumpStats & operator+=(const BGDumpStats & other) {
+        prefiltered_nodes += other.prefiltered_nodes;
+        prefiltered_ways += other.prefiltered_ways;
+        prefiltered_areas += other.prefiltered_areas;
+        discarded_nodes += other.discarded_nodes;
+        discarded_ways += other.discarded_ways;
+        discarded_areas += other.discarded_areas;
+        repaired_geometries += other.repaired_geometries;
+        errors += other.errors;
+        input_vertices += other.input_vertices;
+        output_vertices += other.output_vertices;
+        return *this;
+    }
+};
+
+inline std::ostream & operator<<(std::ostream & os,
+                                 const BGDumpStats & stats) {
+    if(stats.input_vertices > 0)
+        os << "Simplified " << stats.input_vertices << " vertices to "
+           << stats.output_vertices << " ("
+           << 100 * (stats.input_vertices - stats.output_vertices) /
+                  stats.input_vertices
+           << "% less)\n";
+    return os << "Prefiltered " << stats.prefiltered_nodes << " nodes, "
+              << stats.prefiltered_ways << " ways and "
+              << stats.prefiltered_areas << " areas\nDiscarded "
+              << stats.discarded_nodes << " nodes, " << stats.discarded_ways
+              << " ways and " << stats.discarded_areas << " areas, repaired "
+              << stats.repaired_geometries << " geometries";
+}
+
 class BGDumpHandler : public osmium::handler::Handler {
 private:
     osmium::geom::BGFactory m_factory;
 
-    MultipolygonGeo search_area;
+    // shared by the copies of the handler, null if there is no search area
+    std::shared_ptr<const PreparedSearchArea> search_area;
+    // box containing the search area, the whole world if there is none
     BoxGeo search_area_box;
+    // if true, the ways and areas are clipped to the search area instead of
+    // being kept only if covered by, or intersecting, the search area
+    bool clip = false;
+    GeometrySimplifier simplifier;
+    // projections of the inflated geometries, one cache per handler copy
+    ProjectionCache projections;
 
-    template <typename Tags>
-    bool fusion_test(
-        Tags && tags,
-        const std::vector<std::pair<std::string, osmium::StringMatcher>> &
-            filter) {
-        auto tags_first = tags.cbegin();
-        auto tags_last = tags.cend();
-        auto filter_first = filter.cbegin();
-        auto filter_last = filter.cend();
-        while(tags_first != tags_last && filter_first != filter_last) {
-            int r_cmp = tags_first->first.compare(filter_first->first);
-            if(r_cmp < 0) {
-                ++tags_first;
-                continue;
-            }
-            if(r_cmp > 0) return false;
-            if(!filter_first->second(tags_first->second.data())) return false;
-            ++tags_first;
-            ++filter_first;
-        }
-        return filter_first == filter_last;
+    static BoxGeo world_box() noexcept {
+        return BoxGeo(PointGeo(-180, -90), PointGeo(180, 90));
     }
 
     template <typename Tags>
@@ -64,173 +172,343 @@ private:
         return tags_views;
     }
 
-    std::vector<
-        std::pair<std::vector<std::pair<std::string, osmium::StringMatcher>>,
-                  NodeBuilder>>
-        node_filters;
-    std::vector<std::pair<
-        std::vector<std::pair<std::string, osmium::StringMatcher>>, WayBuilder>>
-        way_filters;
-    std::vector<
-        std::pair<std::vector<std::pair<std::string, osmium::StringMatcher>>,
-                  AreaBuilder>>
-        area_filters;
+    RulesIndex<NodeBuilder> node_rules;
+    RulesIndex<WayBuilder> way_rules;
+    RulesIndex<AreaBuilder> area_rules;
 
     std::vector<Node> nodes;
     std::vector<Way> ways;
     std::vector<Area> areas;
 
+    std::shared_ptr<IO::FeatureSink> sink;
+
+    BGDumpStats stats;
+
+    void discard(GeometryError error, std::size_t & discarded, char type,
+                 osmium::object_id_type id) {
+        ++discarded;
+        stats.errors.add(error, type, id);
+    }
+
+    template <typename Feature>
+    void emit(Feature feature, std::vector<Feature> & features) {
+        if(sink)
+            sink->write(feature);
+        else
+            features.emplace_back(std::move(feature));
+    }
+
+    // simplifies the geometry with the tolerance of its pattern, or the
+    // global one if negative, returns false if the geometry collapses
+    template <typename Geometry>
+    bool simplify(Geometry & g, float pattern_tolerance) {
+        const double tolerance = pattern_tolerance >= 0
+                                     ? pattern_tolerance
+                                     : simplifier.getTolerance();
+        if(!simplifier.isActive(tolerance)) return true;
+        stats.input_vertices += boost::geometry::num_points(g);
+        if(!simplifier.simplify(g, tolerance)) return false;
+        stats.output_vertices += boost::geometry::num_points(g);
+        return true;
+    }
+
+    // clips the buffer of an inflated feature if clipping, false if empty
+    bool clip_inflated(MultipolygonGeo & mp) const {
+        if(!search_area || !clip) return true;
+        mp = search_area->clip(std::move(mp));
+        return !mp.empty();
+    }
+
+    template <typename Tags>
+    void emit_way(const WayBuilder & builder, const Tags & tags,
+                  LinestringGeo l) {
+        if(builder.isInflated()) {
+            MultipolygonGeo mp = buffer_LinestringGeo(
+                l, builder.getInflatedWidth(),
+                projections.get(envelope_center(l)));
+            if(clip_inflated(mp) &&
+               simplify(mp, builder.getSimplifyTolerance()))
+                emit(builder.buildInflated(tags, std::move(mp)), areas);
+            return;
+        }
+        if(simplify(l, builder.getSimplifyTolerance()))
+            emit(builder.build(tags, std::move(l)), ways);
+    }
+
 public:
     template <typename NFilters, typename WFilters, typename AFilters>
     BGDumpHandler(NFilters && node_filters, WFilters && way_filters,
                   AFilters && area_filters)
         : osmium::handler::Handler()
-        , search_area_box(boost::geometry::make_inverse<BoxGeo>())
-        , node_filters(std::forward<NFilters>(node_filters))
-        , way_filters(std::forward<WFilters>(way_filters))
-        , area_filters(std::forward<AFilters>(area_filters)) {}
+        , search_area_box(world_box())
+        , node_rules(std::forward<NFilters>(node_filters))
+        , way_rules(std::forward<WFilters>(way_filters))
+        , area_rules(std::forward<AFilters>(area_filters)) {}
 
     template <typename SArea, typename NFilters, typename WFilters,
               typename AFilters>
     BGDumpHandler(SArea && p_search_area, NFilters && node_filters,
                   WFilters && way_filters, AFilters && area_filters)
         : osmium::handler::Handler()
-        , search_area(p_search_area)
-        , search_area_box(boost::geometry::return_envelope<BoxGeo>(search_area))
-        , node_filters(std::forward<NFilters>(node_filters))
-        , way_filters(std::forward<WFilters>(way_filters))
-        , area_filters(std::forward<AFilters>(area_filters)) {}
+        , search_area(prepare_search_area(p_search_area))
+        , search_area_box(search_area ? search_area->getBox() : world_box())
+        , node_rules(std::forward<NFilters>(node_filters))
+        , way_rules(std::forward<WFilters>(way_filters))
+        , area_rules(std::forward<AFilters>(area_filters)) {}
 
     template <typename NFilter, typename... NInfoArgs>
-    void add_node_rule(NFilter && filter, NInfoArgs &&... args) const noexcept {
-        node_filters.emplace_back(std::piecewise_construct,
-                                  std::forward_as_tuple(filter),
-                                  std::forward_as_tuple(args...));
+    void add_node_rule(NFilter && filter, NInfoArgs &&... args) {
+        node_rules.add_rule(std::piecewise_construct,
+                            std::forward_as_tuple(filter),
+                            std::forward_as_tuple(args...));
     }
     template <typename WFilter, typename... WInfoArgs>
-    void add_way_rule(WFilter && filter, WInfoArgs &&... args) const noexcept {
-        way_filters.emplace_back(std::piecewise_construct,
-                                 std::forward_as_tuple(filter),
-                                 std::forward_as_tuple(args...));
+    void add_way_rule(WFilter && filter, WInfoArgs &&... args) {
+        way_rules.add_rule(std::piecewise_construct,
+                           std::forward_as_tuple(filter),
+                           std::forward_as_tuple(args...));
     }
     template <typename AFilter, typename... AInfoArgs>
-    void add_area_rule(AFilter && filter, AInfoArgs &&... args) const noexcept {
-        area_filters.emplace_back(std::piecewise_construct,
-                                  std::forward_as_tuple(filter),
-                                  std::forward_as_tuple(args...));
+    void add_area_rule(AFilter && filter, AInfoArgs &&... args) {
+        area_rules.add_rule(std::piecewise_construct,
+                            std::forward_as_tuple(filter),
+                            std::forward_as_tuple(args...));
+    }
+
+    /**
+     * Prepares the search area, null if empty, to be shared by several
+     * handlers.
+     */
+    static std::shared_ptr<const PreparedSearchArea> prepare_search_area(
+        MultipolygonGeo area, PredicateCS cs = PredicateCS::geographic) {
+        if(area.empty()) return nullptr;
+        return std::make_shared<const PreparedSearchArea>(std::move(area), cs);
     }
 
     template <typename SearchArea>
-    void setSearchArea(SearchArea && area) noexcept {
-        search_area = std::forward<SearchArea>(area);
+    void setSearchArea(SearchArea && area,
+                       PredicateCS cs = PredicateCS::geographic) {
+        setSearchArea(
+            prepare_search_area(std::forward<SearchArea>(area), cs));
+    }
+    // sets an already prepared search area, none if null
+    void setSearchArea(
+        std::shared_ptr<const PreparedSearchArea> prepared_area) noexcept {
+        search_area = std::move(prepared_area);
+        search_area_box = search_area ? search_area->getBox() : world_box();
+    }
+
+    /**
+     * Restricts the entities to the given box, in addition to the search
+     * area if any.
+     */
+    void setSearchBox(const BoxGeo & box) noexcept { search_area_box = box; }
+
+    /**
+     * Outputs the parts of the ways and areas inside the search area instead
+     * of the whole ways covered by it and the whole areas intersecting it.
+     */
+    void setClip(bool clip_to_search_area) noexcept {
+        clip = clip_to_search_area;
+    }
+
+    /**
+     * Simplifies and rounds the ways and areas before outputting them.
+     */
+    void setSimplify(const SimplifyOptions & options) {
+        simplifier = GeometrySimplifier(options, m_factory.validation());
+    }
+
+    void setValidation(ValidationMode mode) noexcept {
+        m_factory.set_validation(mode);
+        simplifier.setValidation(mode);
+    }
+
+    /**
+     * Sends the matched features to the given sink instead of keeping them
+     * in the handler.
+     */
+    void setSink(std::shared_ptr<IO::FeatureSink> feature_sink) noexcept {
+        sink = std::move(feature_sink);
     }
 
     const BoxGeo & getSearchBox() const noexcept { return search_area_box; }
-    const MultipolygonGeo & getSearchArea() const noexcept {
-        return search_area;
+    MultipolygonGeo getSearchArea() const {
+        return search_area ? search_area->getArea() : MultipolygonGeo{};
     }
-    osmium::TagsFilter getAreaEnglobingFilter() const noexcept {
-        osmium::TagsFilter filter{false};
-        for(const auto & rule : area_filters)
+    void addAreaEnglobingRules(osmium::TagsFilter & filter) const {
+        for(const auto & rule : area_rules.getRules())
             for(const auto & [tag, value] : rule.first)
                 filter.add_rule(true, tag, value);
+    }
+    osmium::TagsFilter getAreaEnglobingFilter() const noexcept {
+        osmium::TagsFilter filter{false};
+        addAreaEnglobingRules(filter);
         return filter;
     }
 
+    /**
+     * Tests if the way matches a way rule, regardless of its location.
+     */
+    bool matchesWayRule(const osmium::Way & way) {
+        if(!way_rules.may_match(way.tags())) return false;
+        return way_rules.find(get_sorted_tag_views(way.tags())) != nullptr;
+    }
+
+    bool hasNodeRules() const noexcept { return !node_rules.empty(); }
+    bool hasWayRules() const noexcept { return !way_rules.empty(); }
+    bool hasAreaRules() const noexcept { return !area_rules.empty(); }
+
     const std::vector<Node> & getNodes() const noexcept { return nodes; }
     const std::vector<Way> & getWays() const noexcept { return ways; }
     const std::vector<Area> & getAreas() const noexcept { return areas; }
+    BGDumpStats getStats() const {
+        BGDumpStats s = stats;
+        s.repaired_geometries += m_factory.repaired_count();
+        return s;
+    }
+
+    /**
+     * Moves the results of another handler, typically a per-thread copy of
+     * this one, at the end of the results of this handler.
+     */
+    void merge(BGDumpHandler && other) {
+        nodes.insert(nodes.end(), std::make_move_iterator(other.nodes.begin()),
+                     std::make_move_iterator(other.nodes.end()));
+        ways.insert(ways.end(), std::make_move_iterator(other.ways.begin()),
+                    std::make_move_iterator(other.ways.end()));
+        areas.insert(areas.end(), std::make_move_iterator(other.areas.begin()),
+                     std::make_move_iterator(other.areas.end()));
+        other.nodes.clear();
+        other.ways.clear();
+        other.areas.clear();
+        stats += other.getStats();
+        other.stats = BGDumpStats{};
+        other.m_factory.reset_repaired_count();
+    }
 
     void node(const osmium::Node & node) noexcept {
         try {
-            if(!boost::geometry::covered_by(m_factory.create_point(node),
-                                            search_area_box))
+            if(!node_rules.may_match(node.tags())) {
+                ++stats.prefiltered_nodes;
+                return;
+            }
+            PointGeo p;
+            const GeometryError error =
+                m_factory.try_create_point(node.location(), p);
+            if(error == GeometryError::none &&
+               !boost::geometry::covered_by(p, search_area_box))
                 return;
 
             std::vector<std::pair<std::string_view, std::string_view>> tags =
                 get_sorted_tag_views(node.tags());
 
-            for(auto & [filter, builder] : node_filters) {
-                if(!fusion_test(tags, filter)) continue;
+            const auto * rule = node_rules.find(tags);
+            if(rule == nullptr) return;
+            const auto & builder = rule->second;
 
-                PointGeo p = m_factory.create_point(node);
-                if(!(search_area.empty() ||
-                     boost::geometry::intersects(p, search_area)))
-                    return;
-                nodes.emplace_back(builder.build(tags, std::move(p)));
+            if(error != GeometryError::none) {
+                discard(error, stats.discarded_nodes, 'n', node.id());
+                return;
+            }
+            if(search_area && !search_area->intersects(p)) return;
+            if(builder.isInflated()) {
+                MultipolygonGeo mp = buffer_PointGeo(
+                    p, builder.getInflatedWidth(), projections.get(p));
+                if(clip_inflated(mp) && simplify(mp, -1))
+                    emit(builder.buildInflated(tags, std::move(mp)), areas);
                 return;
             }
-        } catch(const osmium::geometry_error & e) {
-            BOOST_LOG_TRIVIAL(warning)
-                << "Discarded OSM entity: " << e.what() << std::endl;
-        } catch(const osmium::invalid_location & e) {
-            BOOST_LOG_TRIVIAL(warning)
-                << "Discarded OSM entity: " << e.what() << std::endl;
-        } catch(const std::runtime_error & e) {
-            BOOST_LOG_TRIVIAL(warning)
-                << "Discarded OSM entity: " << e.what() << std::endl;
+            emit(builder.build(tags, std::move(p)), nodes);
+        } catch(const std::exception &) {
+            discard(GeometryError::other, stats.discarded_nodes, 'n',
+                    node.id());
         }
     }
     void way(const osmium::Way & way) noexcept {
         try {
-            if(!search_area.empty() &&
-               !boost::geometry::intersects(m_factory.envelope(way),
-                                            search_area_box))
+            if(!way_rules.may_match(way.tags())) {
+                ++stats.prefiltered_ways;
+                return;
+            }
+            // the ways without any located node are discarded below if
+            // they match a rule
+            BoxGeo envelope;
+            if(m_factory.try_envelope(way.envelope(), envelope) ==
+                   GeometryError::none &&
+               !boost::geometry::intersects(envelope, search_area_box))
                 return;
 
             std::vector<std::pair<std::string_view, std::string_view>> tags =
                 get_sorted_tag_views(way.tags());
 
-            for(auto & [filter, builder] : way_filters) {
-                if(!fusion_test(tags, filter)) continue;
+            const auto * rule = way_rules.find(tags);
+            if(rule == nullptr) return;
+            const auto & builder = rule->second;
 
-                LinestringGeo l = m_factory.create_linestring(way);
-                if(!(search_area.empty() ||
-                     boost::geometry::covered_by(l, search_area)))
-                    return;
-                ways.emplace_back(builder.build(tags, std::move(l)));
+            LinestringGeo l;
+            if(GeometryError error = m_factory.try_create_linestring(
+                   way.nodes(), l);
+               error != GeometryError::none) {
+                discard(error, stats.discarded_ways, 'w', way.id());
                 return;
             }
-        } catch(const osmium::geometry_error & e) {
-            BOOST_LOG_TRIVIAL(warning)
-                << "Discarded OSM entity: " << e.what() << std::endl;
-        } catch(const osmium::invalid_location & e) {
-            BOOST_LOG_TRIVIAL(warning)
-                << "Discarded OSM entity: " << e.what() << std::endl;
-        } catch(const std::runtime_error & e) {
-            BOOST_LOG_TRIVIAL(warning)
-                << "Discarded OSM entity: " << e.what() << std::endl;
+            // the buffer of a whole inflated way is clipped rather than the
+            // buffers of its parts, that would stick out of the area
+            if(search_area && clip && builder.isInflated()) {
+                if(search_area->intersects(l))
+                    emit_way(builder, tags, std::move(l));
+                return;
+            }
+            if(search_area && clip) {
+                for(LinestringGeo & part : search_area->clip(std::move(l)))
+                    emit_way(builder, tags, std::move(part));
+                return;
+            }
+            if(search_area && !search_area->covered_by(l)) return;
+            emit_way(builder, tags, std::move(l));
+        } catch(const std::exception &) {
+            discard(GeometryError::other, stats.discarded_ways, 'w', way.id());
         }
     }
     void area(const osmium::Area & area) noexcept {
+        // the areas are identified by their original way or relation
+        const char type = area.from_way() ? 'w' : 'r';
         try {
-            if(!search_area.empty() &&
-               !boost::geometry::intersects(m_factory.envelope(area),
-                                            search_area_box))
+            if(!area_rules.may_match(area.tags())) {
+                ++stats.prefiltered_areas;
+                return;
+            }
+            BoxGeo envelope;
+            if(m_factory.try_envelope(area.envelope(), envelope) ==
+                   GeometryError::none &&
+               !boost::geometry::intersects(envelope, search_area_box))
                 return;
 
             std::vector<std::pair<std::string_view, std::string_view>> tags =
                 get_sorted_tag_views(area.tags());
 
-            for(auto & [filter, builder] : area_filters) {
-                if(!fusion_test(tags, filter)) continue;
+            const auto * rule = area_rules.find(tags);
+            if(rule == nullptr) return;
+            const auto & builder = rule->second;
 
-                MultipolygonGeo mp = m_factory.create_multipolygon(area);
-                if(!(search_area.empty() ||
-                     boost::geometry::intersects(mp, search_area)))
-                    return;
-                areas.emplace_back(builder.build(tags, std::move(mp)));
+            MultipolygonGeo mp;
+            if(GeometryError error =
+                   m_factory.try_create_multipolygon(area, mp);
+               error != GeometryError::none) {
+                discard(error, stats.discarded_areas, type, area.orig_id());
                 return;
             }
-        } catch(const osmium::geometry_error & e) {
-            BOOST_LOG_TRIVIAL(warning)
-                << "Discarded OSM entity: " << e.what() << std::endl;
-        } catch(const osmium::invalid_location & e) {
-            BOOST_LOG_TRIVIAL(warning)
-                << "Discarded OSM entity: " << e.what() << std::endl;
-        } catch(const std::runtime_error & e) {
-            BOOST_LOG_TRIVIAL(warning)
-                << "Discarded OSM entity: " << e.what() << std::endl;
+            if(search_area && clip) {
+                mp = search_area->clip(std::move(mp));
+                if(mp.empty()) return;
+            } else if(search_area && !search_area->intersects(mp))
+                return;
+            if(!simplify(mp, builder.getSimplifyTolerance())) return;
+            emit(builder.build(tags, std::move(mp)), areas);
+        } catch(const std::exception &) {
+            discard(GeometryError::other, stats.discarded_areas, type,
+                    area.orig_id());
         }
     }
 };  // class BGDumpHandler
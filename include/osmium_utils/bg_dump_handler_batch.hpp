@@ -0,0 +1,94 @@
+#ifndef BG_DUMP_HANDLER_BATCH_HPP
+#define BG_DUMP_HANDLER_BATCH_HPP
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <osmium/handler.hpp>
+#include <osmium/tags/tags_filter.hpp>
+
+#include "osmium_utils/bg_dump_handler.hpp"
+
+#include "bg_types.hpp"
+
+/**
+ * @brief Gives the entities of a single pass to several BGDumpHandler, each
+ * built from its own patterns.
+ *
+ * It offers the interface of a BGDumpHandler needed by the query, such that
+ * the relations pass, the location index and the decoding of the input file
+ * are shared by the handlers.
+ */
+class BGDumpHandlerBatch : public osmium::handler::Handler {
+private:
+    std::vector<BGDumpHandler> handlers;
+    BoxGeo search_box;
+
+public:
+    explicit BGDumpHandlerBatch(std::vector<BGDumpHandler> p_handlers)
+        : osmium::handler::Handler()
+        , handlers(std::move(p_handlers))
+        , search_box(boost::geometry::make_inverse<BoxGeo>()) {
+        for(const BGDumpHandler & handler : handlers)
+            boost::geometry::expand(search_box, handler.getSearchBox());
+    }
+
+    const BoxGeo & getSearchBox() const noexcept { return search_box; }
+    osmium::TagsFilter getAreaEnglobingFilter() const noexcept {
+        osmium::TagsFilter filter{false};
+        for(const BGDumpHandler & handler : handlers)
+            handler.addAreaEnglobingRules(filter);
+        return filter;
+    }
+    bool matchesWayRule(const osmium::Way & way) {
+        return std::any_of(handlers.begin(), handlers.end(),
+                           [&way](BGDumpHandler & handler) {
+                               return handler.matchesWayRule(way);
+                           });
+    }
+    bool hasNodeRules() const noexcept {
+        return std::any_of(handlers.cbegin(), handlers.cend(),
+                           [](const BGDumpHandler & handler) {
+                               return handler.hasNodeRules();
+                           });
+    }
+    bool hasWayRules() const noexcept {
+        return std::any_of(handlers.cbegin(), handlers.cend(),
+                           [](const BGDumpHandler & handler) {
+                               return handler.hasWayRules();
+                           });
+    }
+    bool hasAreaRules() const noexcept {
+        return std::any_of(handlers.cbegin(), handlers.cend(),
+                           [](const BGDumpHandler & handler) {
+                               return handler.hasAreaRules();
+                           });
+    }
+
+    const std::vector<BGDumpHandler> & getHandlers() const noexcept {
+        return handlers;
+    }
+    std::vector<BGDumpHandler> release() && { return std::move(handlers); }
+
+    /**
+     * Merges the handlers of another batch, typically a per-thread copy of
+     * this one, into the handlers of this batch.
+     */
+    void merge(BGDumpHandlerBatch && other) {
+        for(std::size_t i = 0; i < handlers.size(); ++i)
+            handlers[i].merge(std::move(other.handlers[i]));
+    }
+
+    void node(const osmium::Node & node) noexcept {
+        for(BGDumpHandler & handler : handlers) handler.node(node);
+    }
+    void way(const osmium::Way & way) noexcept {
+        for(BGDumpHandler & handler : handlers) handler.way(way);
+    }
+    void area(const osmium::Area & area) noexcept {
+        for(BGDumpHandler & handler : handlers) handler.area(area);
+    }
+};  // class BGDumpHandlerBatch
+
+#endif  // BG_DUMP_HANDLER_BATCH_HPP
@@ -58,6 +58,8 @@ DEALINGS IN THE SOFTWARE.
 #include <boost/geometry/geometries/polygon.hpp>
 #include <boost/geometry/geometries/multi_polygon.hpp>
 
+#include "bg_validation.hpp"
+
 namespace osmium {
     namespace geom {
         /**
@@ -73,6 +75,66 @@ namespace osmium {
             using multipolygon_type = boost::geometry::model::multi_polygon<polygon_type>;
             using ring_type         = boost::geometry::model::ring<point_type>;
 
+        private:
+            ValidationMode m_validation = ValidationMode::full;
+            // number of invalid geometries repaired since the last reset
+            mutable std::size_t m_repaired = 0;
+
+            [[noreturn]] static void throw_error(GeometryError error, const char* object_type, osmium::object_id_type id) {
+                if (error == GeometryError::invalid_location)
+                    throw osmium::invalid_location{"invalid location"};
+                osmium::geometry_error e{geometry_error_name(error)};
+                e.set_id(object_type, id);
+                throw e;
+            }
+
+            template <typename Iterator, typename Points>
+            static GeometryError create_points(Iterator first, Iterator last, Points& points) {
+                points.clear();
+                points.reserve(static_cast<std::size_t>(std::distance(first, last)));
+                for (; first != last; ++first) {
+                    const osmium::Location location = first->location();
+                    if (! location.valid())
+                        return GeometryError::invalid_location;
+                    points.emplace_back(location.lon_without_check(), location.lat_without_check());
+                }
+                return GeometryError::none;
+            }
+
+            template <typename NodeList, typename Points>
+            static GeometryError create_points(const NodeList& nodes, Points& points, direction dir) {
+                if (dir == direction::forward)
+                    return create_points(nodes.cbegin(), nodes.cend(), points);
+                return create_points(nodes.crbegin(), nodes.crend(), points);
+            }
+
+            // validates the multipolygon, repairing it in repair mode
+            GeometryError validate(multipolygon_type& mp) const {
+                switch (m_validation) {
+                    case ValidationMode::none:
+                        return GeometryError::none;
+                    case ValidationMode::fast:
+                        return fast_check_multipolygon(mp);
+                    case ValidationMode::full:
+                        return validity_error(mp);
+                    case ValidationMode::repair:
+                        break;
+                }
+                if (boost::geometry::is_valid(mp))
+                    return GeometryError::none;
+                return repair(mp);
+            }
+
+            // repairs a multipolygon known to be invalid
+            GeometryError repair(multipolygon_type& mp) const {
+                multipolygon_type r = repair_multipolygon(mp);
+                if (r.empty() || ! boost::geometry::is_valid(r))
+                    return GeometryError::repair_failed;
+                ++m_repaired;
+                mp = std::move(r);
+                return GeometryError::none;
+            }
+
         public:
             BGFactory() { }
             BGFactory(const BGFactory &) = default;
@@ -84,8 +146,27 @@ namespace osmium {
             int epsg() const noexcept { return 4326; }
             std::string proj_string() const { return "+proj=longlat +datum=WGS84 +no_defs"; }
 
+            void set_validation(ValidationMode mode) noexcept { m_validation = mode; }
+            ValidationMode validation() const noexcept { return m_validation; }
+
+            std::size_t repaired_count() const noexcept { return m_repaired; }
+            void reset_repaired_count() noexcept { m_repaired = 0; }
+
+            /*
+             * The try_create_* functions report the errors by their return
+             * value instead of throwing, the geometry is only meaningful if
+             * they return GeometryError::none.
+             */
+
             /* Point */
 
+            GeometryError try_create_point(const osmium::Location& location, point_type& p) const noexcept {
+                if (! location.valid())
+                    return GeometryError::invalid_location;
+                p = point_type(location.lon_without_check(), location.lat_without_check());
+                return GeometryError::none;
+            }
+
             point_type create_point(const osmium::Location& location) const {
                 return point_type(location.lon(), location.lat());
             }
@@ -110,110 +191,125 @@ namespace osmium {
 
             /* LineString */
 
-            linestring_type create_linestring(const osmium::WayNodeList& wnl, use_nodes un = use_nodes::unique, direction dir = direction::forward) const {
-                linestring_type l;
+            GeometryError try_create_linestring(const osmium::WayNodeList& wnl, linestring_type& l, use_nodes un = use_nodes::unique, direction dir = direction::forward) const {
+                if (GeometryError error = create_points(wnl, l, dir); error != GeometryError::none)
+                    return error;
 
-                l.resize(wnl.size());
-                if(dir == direction::forward)
-                    std::transform(wnl.cbegin(), wnl.cend(), l.begin(), [&](const osmium::NodeRef& n){ return create_point(n); });
-                else
-                    std::transform(wnl.crbegin(), wnl.crend(), l.begin(), [&](const osmium::NodeRef& n){ return create_point(n); });
-                
                 if(un == use_nodes::unique)
                     boost::geometry::unique(l);
 
                 if(l.size() < 2)
-                    throw osmium::geometry_error{"need at least two points for linestring"};
+                    return GeometryError::few_points;
 
-                if(! boost::geometry::is_valid(l)) {
-                    std::string m;
-                    boost::geometry::is_valid(l, m);
-                    throw osmium::geometry_error{m};
-                }
+                // not checked in fast mode, a linestring of distinct points is
+                // only invalid with non finite coordinates, which osmium
+                // locations cannot have
+                if (m_validation == ValidationMode::full || m_validation == ValidationMode::repair)
+                    return validity_error(l);
 
+                return GeometryError::none;
+            }
+
+            linestring_type create_linestring(const osmium::WayNodeList& wnl, use_nodes un = use_nodes::unique, direction dir = direction::forward) const {
+                linestring_type l;
+                if (GeometryError error = try_create_linestring(wnl, l, un, dir); error != GeometryError::none)
+                    throw_error(error, "way", 0);
                 return l;
             }
 
             linestring_type create_linestring(const osmium::Way& way, use_nodes un = use_nodes::unique, direction dir = direction::forward) const {
-                try {
-                    return create_linestring(way.nodes(), un, dir);
-                } catch (osmium::geometry_error& e) {
-                    e.set_id("way", way.id());
-                    throw;
-                }
+                linestring_type l;
+                if (GeometryError error = try_create_linestring(way.nodes(), l, un, dir); error != GeometryError::none)
+                    throw_error(error, "way", way.id());
+                return l;
             }
 
             /* Polygon */
 
-            polygon_type create_polygon(const osmium::WayNodeList& wnl, use_nodes un = use_nodes::unique, direction dir = direction::forward) const {
-                polygon_type p;
+            GeometryError try_create_polygon(const osmium::WayNodeList& wnl, polygon_type& p, use_nodes un = use_nodes::unique, direction dir = direction::forward) const {
+                if (GeometryError error = create_points(wnl, p.outer(), dir); error != GeometryError::none)
+                    return error;
 
-                p.outer().resize(wnl.size());
-                if(dir == direction::forward)
-                    std::transform(wnl.cbegin(), wnl.cend(), p.outer().begin(), [&](const osmium::NodeRef& n){ return create_point(n); });
-                else
-                    std::transform(wnl.crbegin(), wnl.crend(), p.outer().begin(), [&](const osmium::NodeRef& n){ return create_point(n); });
-                
                 if (un == use_nodes::unique)
                     boost::geometry::unique(p);
 
                 if (p.outer().size() < 4)
-                    throw osmium::geometry_error{"need at least four points for polygon"};
-
-                if (! boost::geometry::is_valid(p)) {
-                    std::string m;
-                    boost::geometry::is_valid(p, m);
-                    throw osmium::geometry_error{m};
+                    return GeometryError::few_points;
+
+                switch (m_validation) {
+                    case ValidationMode::none:
+                        return GeometryError::none;
+                    case ValidationMode::fast:
+                        return fast_check_polygon(p);
+                    case ValidationMode::full:
+                        return validity_error(p);
+                    case ValidationMode::repair:
+                        break;
                 }
-                
+                if (boost::geometry::is_valid(p))
+                    return GeometryError::none;
+                multipolygon_type mp;
+                mp.push_back(std::move(p));
+                if (GeometryError error = repair(mp); error != GeometryError::none)
+                    return error;
+                if (mp.size() != 1)
+                    return GeometryError::repair_failed;
+                p = std::move(mp.front());
+                return GeometryError::none;
+            }
+
+            polygon_type create_polygon(const osmium::WayNodeList& wnl, use_nodes un = use_nodes::unique, direction dir = direction::forward) const {
+                polygon_type p;
+                if (GeometryError error = try_create_polygon(wnl, p, un, dir); error != GeometryError::none)
+                    throw_error(error, "way", 0);
                 return p;
             }
 
             polygon_type create_polygon(const osmium::Way& way, use_nodes un = use_nodes::unique, direction dir = direction::forward) const {
-                try {
-                    return create_polygon(way.nodes(), un, dir);
-                } catch (osmium::geometry_error& e) {
-                    e.set_id("way", way.id());
-                    throw;
-                }
+                polygon_type p;
+                if (GeometryError error = try_create_polygon(way.nodes(), p, un, dir); error != GeometryError::none)
+                    throw_error(error, "way", way.id());
+                return p;
             }
 
             /* MultiPolygon */
 
-            multipolygon_type create_multipolygon(const osmium::Area& area) const {
-                try {
-                    multipolygon_type mp;
-                    polygon_type * current_polygon = nullptr;
-                    for (const auto& item : area) {
-                        if (item.type() == osmium::item_type::outer_ring) {
-                            const auto& ring = static_cast<const osmium::OuterRing&>(item);
-                            current_polygon = &mp.emplace_back();
-                            current_polygon->outer().resize(ring.size());
-                            std::transform(ring.crbegin(), ring.crend(), current_polygon->outer().begin(), 
-                                    [&](const osmium::NodeRef& n){ return create_point(n); });
-                        } else if (item.type() == osmium::item_type::inner_ring) {
-                            const auto& ring = static_cast<const osmium::InnerRing&>(item);
-                            ring_type & current_ring = current_polygon->inners().emplace_back();
-                            current_ring.resize(ring.size());
-                            std::transform(ring.crbegin(), ring.crend(), current_ring.begin(), 
-                                    [&](const osmium::NodeRef& n){ return create_point(n); });
-                        }
+            GeometryError try_create_multipolygon(const osmium::Area& area, multipolygon_type& mp) const {
+                mp.clear();
+                polygon_type * current_polygon = nullptr;
+                for (const auto& item : area) {
+                    if (item.type() == osmium::item_type::outer_ring) {
+                        const auto& ring = static_cast<const osmium::OuterRing&>(item);
+                        current_polygon = &mp.emplace_back();
+                        if (GeometryError error = create_points(ring, current_polygon->outer(), direction::backward); error != GeometryError::none)
+                            return error;
+                    } else if (item.type() == osmium::item_type::inner_ring) {
+                        const auto& ring = static_cast<const osmium::InnerRing&>(item);
+                        ring_type & current_ring = current_polygon->inners().emplace_back();
+                        if (GeometryError error = create_points(ring, current_ring, direction::backward); error != GeometryError::none)
+                            return error;
                     }
+                }
 
-                    if(mp.empty())
-                        throw osmium::geometry_error{"invalid area"};
+                if(mp.empty())
+                    return GeometryError::few_points;
 
-                    if(!boost::geometry::is_valid(mp)) {
-                        std::string m;
-                        boost::geometry::is_valid(mp, m);
-                        throw osmium::geometry_error{m};
-                    }
+                return validate(mp);
+            }
 
-                    return mp;
-                } catch (osmium::geometry_error& e) {
-                    e.set_id("area", area.id());
-                    throw;
-                }
+            multipolygon_type create_multipolygon(const osmium::Area& area) const {
+                multipolygon_type mp;
+                if (GeometryError error = try_create_multipolygon(area, mp); error != GeometryError::none)
+                    throw_error(error, "area", area.id());
+                return mp;
+            }
+
+            GeometryError try_envelope(const osmium::Box& box, box_type& b) const noexcept {
+                if (! box.valid())
+                    return GeometryError::invalid_location;
+                b = box_type(point_type(box.bottom_left().lon_without_check(), box.bottom_left().lat_without_check()),
+                             point_type(box.top_right().lon_without_check(), box.top_right().lat_without_check()));
+                return GeometryError::none;
             }
 
             template<class T>
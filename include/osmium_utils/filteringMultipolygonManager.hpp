@@ -51,6 +51,7 @@ DEALINGS IN THE SOFTWARE.
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <utility>
 #include <vector>
 
 #include "osmium_utils/bg_factory.hpp"
@@ -87,6 +88,40 @@ class FilteringMultipolygonManager
     osmium::TagsFilter m_filter;
     BoxGeo m_box;
 
+    // the completed relations, each followed by its member ways, and the
+    // closed ways whose areas are to be assembled
+    static constexpr std::size_t initial_jobs_capacity = 1024 * 1024;
+    bool m_deferred = false;
+    osmium::memory::Buffer m_jobs;
+
+    osmium::memory::Buffer & jobs() {
+        if(!m_jobs)
+            m_jobs = osmium::memory::Buffer{
+                initial_jobs_capacity, osmium::memory::Buffer::auto_grow::yes};
+        return m_jobs;
+    }
+
+    void assemble_relation(const osmium::Relation & relation,
+                           const std::vector<const osmium::Way *> & ways,
+                           osmium::memory::Buffer & output) const {
+        try {
+            TAssembler assembler{m_assembler_config};
+            assembler(relation, ways, output);
+        } catch(const osmium::invalid_location &) {
+            // XXX ignore
+        }
+    }
+
+    void assemble_way(const osmium::Way & way,
+                      osmium::memory::Buffer & output) const {
+        try {
+            TAssembler assembler{m_assembler_config};
+            assembler(way, output);
+        } catch(const osmium::invalid_location &) {
+            // XXX ignore
+        }
+    }
+
 public:
     /**
      * Construct a FilteringMultipolygonManager.
@@ -111,6 +146,56 @@ public:
      */
     const area_stats & stats() const noexcept { return m_stats; }
 
+    /**
+     * Defers the assembling of the areas: the completed relations and the
+     * closed ways are copied to a jobs buffer, taken with release_jobs()
+     * and assembled with assemble(), typically by other threads. The
+     * statistics do not count the deferred assemblies.
+     */
+    void defer_assembly() noexcept { m_deferred = true; }
+
+    /**
+     * Takes the jobs queued since the last call, an invalid buffer if
+     * there is none.
+     */
+    osmium::memory::Buffer release_jobs() {
+        if(!m_jobs || m_jobs.committed() == 0) return osmium::memory::Buffer{};
+        return std::move(m_jobs);
+    }
+
+    /**
+     * Assembles the areas of the given jobs into the output buffer. It only
+     * reads the assembler config, so it may run concurrently with the
+     * handling of the next entities and with other assemble() calls.
+     */
+    void assemble(const osmium::memory::Buffer & jobs_buffer,
+                  osmium::memory::Buffer & output) const {
+        const osmium::Relation * relation = nullptr;
+        std::size_t nb_ways = 0;
+        std::vector<const osmium::Way *> ways;
+        for(const auto & object : jobs_buffer.select<osmium::OSMObject>()) {
+            if(object.type() == osmium::item_type::relation) {
+                relation = static_cast<const osmium::Relation *>(&object);
+                nb_ways = static_cast<std::size_t>(std::count_if(
+                    relation->members().cbegin(), relation->members().cend(),
+                    [](const RelationMember & member) {
+                        return member.ref() != 0;
+                    }));
+                ways.clear();
+                continue;
+            }
+            const auto & way = static_cast<const osmium::Way &>(object);
+            if(relation == nullptr) {
+                assemble_way(way, output);
+                continue;
+            }
+            ways.push_back(&way);
+            if(ways.size() < nb_ways) continue;
+            assemble_relation(*relation, ways, output);
+            relation = nullptr;
+        }
+    }
+
     /**
      * We are interested in all relations tagged with type=multipolygon
      * or type=boundary with at least one way member.
@@ -156,6 +241,14 @@ public:
            }))
             return;
 
+        if(m_deferred) {
+            osmium::memory::Buffer & buffer = jobs();
+            buffer.add_item(relation);
+            for(const osmium::Way * way : ways) buffer.add_item(*way);
+            buffer.commit();
+            return;
+        }
+
         try {
             TAssembler assembler{m_assembler_config};
             assembler(relation, ways, this->buffer());
@@ -185,6 +278,13 @@ public:
                     return;
                 }
 
+                if(m_deferred) {
+                    osmium::memory::Buffer & buffer = jobs();
+                    buffer.add_item(way);
+                    buffer.commit();
+                    return;
+                }
+
                 TAssembler assembler{m_assembler_config};
                 assembler(way, this->buffer());
                 m_stats += assembler.stats();
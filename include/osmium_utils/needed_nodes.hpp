@@ -0,0 +1,105 @@
+#ifndef NEEDED_NODES_HPP
+#define NEEDED_NODES_HPP
+
+#include <osmium/handler.hpp>
+#include <osmium/index/id_set.hpp>
+#include <osmium/osm/item_type.hpp>
+#include <osmium/osm/node.hpp>
+#include <osmium/osm/relation.hpp>
+#include <osmium/osm/way.hpp>
+#include <osmium/tags/taglist.hpp>
+#include <osmium/tags/tags_filter.hpp>
+
+using node_id_set_type =
+    osmium::index::IdSetDense<osmium::unsigned_object_id_type>;
+
+/**
+ * @brief Collects the ids of the nodes whose locations are needed to build
+ * the ways and areas of a BGDumpHandler, or of a BGDumpHandlerBatch.
+ *
+ * It is first given the relations, like a relations manager of
+ * osmium::relations::read_relations, to find the member ways of the
+ * multipolygons accepted by the multipolygon manager. Then it is given the
+ * ways and records the nodes of the member ways, of the ways matching a way
+ * rule and of the ways that may be closed matching the area englobing
+ * filter.
+ *
+ * @tparam MPManager The multipolygon manager of the main pass.
+ * @tparam DumpHandler The handler of the main pass.
+ */
+template <typename MPManager, typename DumpHandler>
+class NeededNodesCollector : public osmium::handler::Handler {
+private:
+    DumpHandler & bg_handler;
+    const MPManager & mp_manager;
+    osmium::TagsFilter area_filter;
+
+    node_id_set_type member_ways;
+    node_id_set_type needed_nodes;
+
+    bool may_be_area(const osmium::Way & way) const {
+        // same conditions as the multipolygon manager, except the closure
+        // that it tests on the locations, not known yet: a way may be closed
+        // by two distinct nodes at the same location
+        return way.nodes().size() > 3 &&
+               !way.tags().has_tag("area", "no") &&
+               osmium::tags::match_any_of(way.tags(), area_filter);
+    }
+
+public:
+    NeededNodesCollector(DumpHandler & p_bg_handler,
+                         const MPManager & p_mp_manager)
+        : bg_handler(p_bg_handler)
+        , mp_manager(p_mp_manager)
+        , area_filter(p_bg_handler.getAreaEnglobingFilter()) {}
+
+    void relation(const osmium::Relation & relation) {
+        if(!mp_manager.new_relation(relation)) return;
+        for(const auto & member : relation.members())
+            if(member.type() == osmium::item_type::way)
+                member_ways.set(member.positive_ref());
+    }
+
+    // called by osmium::relations::read_relations after the relations
+    void prepare_for_lookup() noexcept {}
+
+    void way(const osmium::Way & way) {
+        if(!member_ways.get(way.positive_id()) &&
+           !bg_handler.matchesWayRule(way) && !may_be_area(way))
+            return;
+        for(const auto & node_ref : way.nodes())
+            needed_nodes.set(node_ref.positive_ref());
+    }
+
+    const node_id_set_type & getNeededNodes() const noexcept {
+        return needed_nodes;
+    }
+};
+
+/**
+ * @brief Forwards to a node locations handler only the nodes of a given id
+ * set, or every node if no set is given, and every way.
+ *
+ * @tparam LocationHandler The osmium::handler::NodeLocationsForWays to filter.
+ */
+template <typename LocationHandler>
+class NeededNodeLocationsForWays : public osmium::handler::Handler {
+private:
+    LocationHandler & location_handler;
+    const node_id_set_type * needed_nodes;
+
+public:
+    explicit NeededNodeLocationsForWays(
+        LocationHandler & p_location_handler,
+        const node_id_set_type * p_needed_nodes = nullptr)
+        : location_handler(p_location_handler), needed_nodes(p_needed_nodes) {}
+
+    void node(const osmium::Node & node) {
+        if(needed_nodes == nullptr || needed_nodes->get(node.positive_id()))
+            location_handler.node(node);
+    }
+
+    void way(osmium::Way & way) { location_handler.way(way); }
+};
+
+#endif  // NEEDED_NODES_HPP
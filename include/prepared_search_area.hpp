@@ -0,0 +1,437 @@
+#ifndef PREPARED_SEARCH_AREA_HPP
+#define PREPARED_SEARCH_AREA_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/geometry.hpp>
+#include <boost/geometry/index/rtree.hpp>
+
+#include "bg_types.hpp"
+
+/**
+ * @brief Coordinate system of the exact spatial predicates of a
+ * PreparedSearchArea.
+ *
+ * cartesian: longitudes and latitudes as planar coordinates, segments are
+ *            straight lines in the plate carree projection.
+ * spherical: segments are great circle arcs.
+ * geographic: segments are geodesics of the WGS84 ellipsoid, the slowest.
+ */
+enum class PredicateCS { cartesian, spherical, geographic };
+
+inline PredicateCS predicate_cs_from_string(const std::string & name) {
+    if(name == "cartesian") return PredicateCS::cartesian;
+    if(name == "spherical") return PredicateCS::spherical;
+    if(name == "geographic") return PredicateCS::geographic;
+    throw std::invalid_argument("unknown predicate coordinate system " + name);
+}
+
+namespace detail {
+// copies of the geometries with the points of another coordinate system
+template <typename Point>
+Point with_cs(const PointGeo & p) {
+    return Point(p.x(), p.y());
+}
+template <typename Point, typename SourcePoint>
+boost::geometry::model::linestring<Point> with_cs(
+    const boost::geometry::model::linestring<SourcePoint> & l) {
+    boost::geometry::model::linestring<Point> converted;
+    converted.reserve(l.size());
+    for(const SourcePoint & p : l) converted.emplace_back(p.x(), p.y());
+    return converted;
+}
+template <typename Point, typename SourcePoint>
+boost::geometry::model::multi_linestring<
+    boost::geometry::model::linestring<Point>>
+with_cs(const boost::geometry::model::multi_linestring<
+        boost::geometry::model::linestring<SourcePoint>> & ml) {
+    boost::geometry::model::multi_linestring<
+        boost::geometry::model::linestring<Point>>
+        converted;
+    converted.reserve(ml.size());
+    for(const auto & l : ml) converted.push_back(with_cs<Point>(l));
+    return converted;
+}
+template <typename Point, typename SourcePoint>
+boost::geometry::model::multi_polygon<boost::geometry::model::polygon<Point>>
+with_cs(const boost::geometry::model::multi_polygon<
+        boost::geometry::model::polygon<SourcePoint>> & mp) {
+    auto convert_ring = [](const auto & ring, auto & converted) {
+        converted.reserve(ring.size());
+        for(const SourcePoint & p : ring) converted.emplace_back(p.x(), p.y());
+    };
+    boost::geometry::model::multi_polygon<
+        boost::geometry::model::polygon<Point>>
+        converted;
+    for(const auto & polygon : mp) {
+        auto & converted_polygon = converted.emplace_back();
+        convert_ring(polygon.outer(), converted_polygon.outer());
+        for(const auto & inner : polygon.inners())
+            convert_ring(inner, converted_polygon.inners().emplace_back());
+    }
+    return converted;
+}
+}  // namespace detail
+
+/**
+ * @brief Search area prepared for the repeated tests of the entities.
+ *
+ * The bounding box of the area is divided in a grid whose cells are
+ * classified as inside, outside or crossed by the boundary of the area,
+ * with summed area tables of the inside and outside cells to decide in O(1)
+ * if a box is inside or outside the area. The envelopes of the boundary
+ * segments are indexed by an R-tree that tells if a box overlapping the
+ * boundary cells actually avoids the boundary. Only the entities that cannot
+ * be decided this way are tested exactly against the area, in the chosen
+ * coordinate system.
+ */
+class PreparedSearchArea {
+public:
+    enum class Location { inside, outside, boundary };
+
+private:
+    using SegmentGeo = boost::geometry::model::segment<PointGeo>;
+    using RTree =
+        boost::geometry::index::rtree<Box2D, boost::geometry::index::rstar<16>>;
+
+    MultipolygonGeo area;
+    BoxGeo box;
+    PredicateCS cs;
+    // copies of the area for the exact tests in the other coordinate systems
+    Multipolygon2D area_2D;
+    MultipolygonSph area_sph;
+    RTree segments_rtree;
+
+    std::size_t nb_columns;
+    std::size_t nb_rows;
+    double cell_width;
+    double cell_height;
+    std::vector<Location> cells;
+    // number of inside and outside cells in the cells [0,i)x[0,j)
+    std::vector<std::uint32_t> inside_sums;
+    std::vector<std::uint32_t> outside_sums;
+
+    static Box2D to_box2D(const BoxGeo & b) {
+        return Box2D(Point2D(b.min_corner().x(), b.min_corner().y()),
+                     Point2D(b.max_corner().x(), b.max_corner().y()));
+    }
+
+    template <typename Geometry>
+    bool exact_intersects(const Geometry & g) const {
+        switch(cs) {
+            case PredicateCS::cartesian:
+                return boost::geometry::intersects(
+                    detail::with_cs<Point2D>(g), area_2D);
+            case PredicateCS::spherical:
+                return boost::geometry::intersects(
+                    detail::with_cs<PointSph>(g), area_sph);
+            default:
+                return boost::geometry::intersects(g, area);
+        }
+    }
+    template <typename Geometry>
+    bool exact_covered_by(const Geometry & g) const {
+        switch(cs) {
+            case PredicateCS::cartesian:
+                return boost::geometry::covered_by(
+                    detail::with_cs<Point2D>(g), area_2D);
+            case PredicateCS::spherical:
+                return boost::geometry::covered_by(
+                    detail::with_cs<PointSph>(g), area_sph);
+            default:
+                return boost::geometry::covered_by(g, area);
+        }
+    }
+
+    // intersection computed on copies with the points of the given system
+    template <typename Point, typename Result, typename Geometry,
+              typename Area>
+    static Result intersection_with_cs(const Geometry & g, const Area & a) {
+        decltype(detail::with_cs<Point>(std::declval<const Result &>())) parts;
+        boost::geometry::intersection(detail::with_cs<Point>(g), a, parts);
+        return detail::with_cs<PointGeo>(parts);
+    }
+    template <typename Result, typename Geometry>
+    Result exact_intersection(const Geometry & g) const {
+        switch(cs) {
+            case PredicateCS::cartesian:
+                return intersection_with_cs<Point2D, Result>(g, area_2D);
+            case PredicateCS::spherical:
+                return intersection_with_cs<PointSph, Result>(g, area_sph);
+            default:
+                Result parts;
+                boost::geometry::intersection(g, area, parts);
+                return parts;
+        }
+    }
+
+    std::size_t column(double x) const {
+        const double c = std::floor((x - box.min_corner().x()) / cell_width);
+        return static_cast<std::size_t>(
+            std::clamp(c, 0.0, static_cast<double>(nb_columns - 1)));
+    }
+    std::size_t row(double y) const {
+        const double r = std::floor((y - box.min_corner().y()) / cell_height);
+        return static_cast<std::size_t>(
+            std::clamp(r, 0.0, static_cast<double>(nb_rows - 1)));
+    }
+    PointGeo cell_center(std::size_t i, std::size_t j) const {
+        return PointGeo(
+            box.min_corner().x() + (static_cast<double>(i) + 0.5) * cell_width,
+            box.min_corner().y() +
+                (static_cast<double>(j) + 0.5) * cell_height);
+    }
+
+    std::uint32_t sum(const std::vector<std::uint32_t> & sums, std::size_t i0,
+                      std::size_t j0, std::size_t i1, std::size_t j1) const {
+        const std::size_t w = nb_columns + 1;
+        return sums[j1 * w + i1] - sums[j0 * w + i1] - sums[j1 * w + i0] +
+               sums[j0 * w + i0];
+    }
+
+    // marks the cells overlapped by the envelopes of the boundary segments
+    // and indexes these envelopes
+    void index_segments() {
+        std::vector<Box2D> envelopes;
+        auto add_ring = [&](const RingGeo & ring) {
+            for(std::size_t k = 1; k < ring.size(); ++k) {
+                const BoxGeo envelope =
+                    boost::geometry::return_envelope<BoxGeo>(
+                        SegmentGeo(ring[k - 1], ring[k]));
+                envelopes.push_back(to_box2D(envelope));
+                for(std::size_t j = row(envelope.min_corner().y());
+                    j <= row(envelope.max_corner().y()); ++j)
+                    for(std::size_t i = column(envelope.min_corner().x());
+                        i <= column(envelope.max_corner().x()); ++i)
+                        cells[j * nb_columns + i] = Location::boundary;
+            }
+        };
+        for(const PolygonGeo & polygon : area) {
+            add_ring(polygon.outer());
+            for(const RingGeo & inner : polygon.inners()) add_ring(inner);
+        }
+        segments_rtree = RTree(envelopes);
+    }
+
+    // The cells of a connected component of non boundary cells are all on
+    // the same side of the boundary, one exact test per component suffices.
+    void classify_cells() {
+        constexpr std::size_t unclassified = static_cast<std::size_t>(-1);
+        std::vector<std::size_t> component(cells.size(), unclassified);
+        std::vector<std::size_t> stack;
+        for(std::size_t seed = 0; seed < cells.size(); ++seed) {
+            if(cells[seed] == Location::boundary ||
+               component[seed] != unclassified)
+                continue;
+            const Location location =
+                exact_covered_by(
+                    cell_center(seed % nb_columns, seed / nb_columns))
+                    ? Location::inside
+                    : Location::outside;
+            stack.push_back(seed);
+            component[seed] = seed;
+            while(!stack.empty()) {
+                const std::size_t c = stack.back();
+                stack.pop_back();
+                cells[c] = location;
+                const std::size_t i = c % nb_columns;
+                const std::size_t j = c / nb_columns;
+                auto visit = [&](std::size_t n) {
+                    if(cells[n] == Location::boundary ||
+                       component[n] != unclassified)
+                        return;
+                    component[n] = seed;
+                    stack.push_back(n);
+                };
+                if(i > 0) visit(c - 1);
+                if(i + 1 < nb_columns) visit(c + 1);
+                if(j > 0) visit(c - nb_columns);
+                if(j + 1 < nb_rows) visit(c + nb_columns);
+            }
+        }
+    }
+
+    void compute_sums() {
+        const std::size_t w = nb_columns + 1;
+        inside_sums.assign(w * (nb_rows + 1), 0);
+        outside_sums.assign(w * (nb_rows + 1), 0);
+        for(std::size_t j = 0; j < nb_rows; ++j) {
+            for(std::size_t i = 0; i < nb_columns; ++i) {
+                const Location location = cells[j * nb_columns + i];
+                const std::size_t s = (j + 1) * w + (i + 1);
+                inside_sums[s] = inside_sums[s - 1] + inside_sums[s - w] -
+                                 inside_sums[s - w - 1] +
+                                 (location == Location::inside);
+                outside_sums[s] = outside_sums[s - 1] + outside_sums[s - w] -
+                                  outside_sums[s - w - 1] +
+                                  (location == Location::outside);
+            }
+        }
+    }
+
+public:
+    /**
+     * @param p_area The search area, not empty.
+     * @param p_cs Coordinate system of the exact tests.
+     * @param max_grid_size Maximal number of cells along each axis, the grid
+     *                      has about one cell per boundary segment.
+     */
+    explicit PreparedSearchArea(MultipolygonGeo p_area,
+                                PredicateCS p_cs = PredicateCS::geographic,
+                                std::size_t max_grid_size = 1024)
+        : area(std::move(p_area))
+        , box(boost::geometry::return_envelope<BoxGeo>(area))
+        , cs(p_cs) {
+        if(cs == PredicateCS::cartesian)
+            area_2D = detail::with_cs<Point2D>(area);
+        else if(cs == PredicateCS::spherical)
+            area_sph = detail::with_cs<PointSph>(area);
+        std::size_t nb_segments = 0;
+        for(const PolygonGeo & polygon : area) {
+            nb_segments += polygon.outer().size();
+            for(const RingGeo & inner : polygon.inners())
+                nb_segments += inner.size();
+        }
+        const std::size_t grid_size = std::clamp<std::size_t>(
+            static_cast<std::size_t>(std::sqrt(nb_segments)), 1,
+            max_grid_size);
+        nb_columns = nb_rows = grid_size;
+        cell_width = std::max(
+            (box.max_corner().x() - box.min_corner().x()) /
+                static_cast<double>(nb_columns),
+            std::numeric_limits<double>::min());
+        cell_height = std::max(
+            (box.max_corner().y() - box.min_corner().y()) /
+                static_cast<double>(nb_rows),
+            std::numeric_limits<double>::min());
+        cells.assign(nb_columns * nb_rows, Location::outside);
+
+        index_segments();
+        classify_cells();
+        compute_sums();
+    }
+
+    const MultipolygonGeo & getArea() const noexcept { return area; }
+    const BoxGeo & getBox() const noexcept { return box; }
+    PredicateCS getCS() const noexcept { return cs; }
+
+    /**
+     * Locates a box relatively to the area, boundary meaning that the box
+     * may be inside, outside or crossing the area boundary.
+     */
+    Location locate(const BoxGeo & b) const {
+        // the boxes are compared as longitude and latitude ranges
+        const Box2D b2D = to_box2D(b);
+        if(!boost::geometry::intersects(b2D, to_box2D(box)))
+            return Location::outside;
+        const bool exceeds_box =
+            !boost::geometry::covered_by(b2D, to_box2D(box));
+        const std::size_t i0 = column(b.min_corner().x());
+        const std::size_t i1 = column(b.max_corner().x()) + 1;
+        const std::size_t j0 = row(b.min_corner().y());
+        const std::size_t j1 = row(b.max_corner().y()) + 1;
+        const std::uint32_t nb_cells =
+            static_cast<std::uint32_t>((i1 - i0) * (j1 - j0));
+        const std::uint32_t nb_inside = sum(inside_sums, i0, j0, i1, j1);
+        const std::uint32_t nb_outside = sum(outside_sums, i0, j0, i1, j1);
+        if(nb_inside == nb_cells && !exceeds_box) return Location::inside;
+        if(nb_outside == nb_cells) return Location::outside;
+
+        // a box that avoids the boundary is on the side of its cells that
+        // do not overlap the boundary
+        if(segments_rtree.qbegin(boost::geometry::index::intersects(b2D)) !=
+           segments_rtree.qend())
+            return Location::boundary;
+        if(nb_inside > 0) return Location::inside;
+        if(nb_outside > 0 || exceeds_box) return Location::outside;
+        return exact_covered_by(b.min_corner()) ? Location::inside
+                   : Location::outside;
+    }
+
+    bool intersects(const PointGeo & p) const {
+        switch(locate(BoxGeo(p, p))) {
+            case Location::inside:
+                return true;
+            case Location::outside:
+                return false;
+            default:
+                return exact_intersects(p);
+        }
+    }
+
+    bool intersects(const LinestringGeo & l) const {
+        switch(locate(boost::geometry::return_envelope<BoxGeo>(l))) {
+            case Location::inside:
+                return !l.empty();
+            case Location::outside:
+                return false;
+            default:
+                return exact_intersects(l);
+        }
+    }
+
+    bool covered_by(const LinestringGeo & l) const {
+        switch(locate(boost::geometry::return_envelope<BoxGeo>(l))) {
+            case Location::inside:
+                return true;
+            case Location::outside:
+                return false;
+            default:
+                return exact_covered_by(l);
+        }
+    }
+
+    /**
+     * Parts of the linestring inside the area, in the coordinate system of
+     * the exact tests, the linestring itself if it is inside the area.
+     */
+    MultilinestringGeo clip(LinestringGeo l) const {
+        MultilinestringGeo parts;
+        switch(locate(boost::geometry::return_envelope<BoxGeo>(l))) {
+            case Location::inside:
+                parts.push_back(std::move(l));
+                break;
+            case Location::outside:
+                break;
+            default:
+                parts = exact_intersection<MultilinestringGeo>(l);
+        }
+        return parts;
+    }
+
+    /**
+     * Intersection of the multipolygon with the area, in the coordinate
+     * system of the exact tests, the multipolygon itself if it is inside the
+     * area.
+     */
+    MultipolygonGeo clip(MultipolygonGeo mp) const {
+        switch(locate(boost::geometry::return_envelope<BoxGeo>(mp))) {
+            case Location::inside:
+                return mp;
+            case Location::outside:
+                return MultipolygonGeo{};
+            default:
+                return exact_intersection<MultipolygonGeo>(mp);
+        }
+    }
+
+    bool intersects(const MultipolygonGeo & mp) const {
+        switch(locate(boost::geometry::return_envelope<BoxGeo>(mp))) {
+            case Location::inside:
+                return !mp.empty();
+            case Location::outside:
+                return false;
+            default:
+                return exact_intersects(mp);
+        }
+    }
+};
+
+#endif  // PREPARED_SEARCH_AREA_HPP
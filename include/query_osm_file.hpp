@@ -3,6 +3,7 @@
 
 #include <filesystem>  // filesystem::path
 #include <fstream>
+#include <string>
 
 #include <boost/range/algorithm.hpp>
 #include <boost/range/adaptors.hpp>
@@ -13,16 +14,74 @@
 #include <osmium/handler/node_locations_for_ways.hpp>
 #include <osmium/io/any_input.hpp>
 #include <osmium/visitor.hpp>
-#include <osmium/index/map/flex_mem.hpp>
 
 #include "osmium_utils/bg_dump_handler.hpp"
+#include "io/feature_sink.hpp"
 #include "io/parse_patterns.hpp"
+#include "io/regions_router.hpp"
 
+struct QueryOptions {
+    // number of threads running the BGDumpHandler callbacks, 1 keeps the
+    // whole main pass on the calling thread
+    unsigned nb_threads = 1;
+    // node locations index, a libosmium map type followed by ",<file>" for
+    // the file based ones, or "auto[,<file>]" to choose it from the input
+    // file size and the memory budget
+    std::string location_index = "flex_mem";
+    // memory, in bytes, that the "auto" location index may use
+    std::size_t memory_budget = std::size_t{8} << 30;
+    // if true, a pre-pass over the ways finds the nodes needed by the ways
+    // and areas rules and only their locations are indexed
+    bool needed_nodes_only = false;
+    // if not empty, directory caching the node locations and multipolygon
+    // relations of the input files for the next queries
+    std::filesystem::path cache_dir;
+    // validation of the built geometries
+    ValidationMode validation = ValidationMode::full;
+    // coordinate system of the exact tests against the search area
+    PredicateCS predicate_cs = PredicateCS::geographic;
+    // if true, the ways and areas are clipped to the search area
+    bool clip = false;
+    // simplification and rounding of the output ways and areas
+    SimplifyOptions simplify;
+};
+
+bool is_location_index_type(const std::string & location_index);
+
+/**
+ * Builds the search area from the multipolygon relations of the input file
+ * that match the area patterns of the given patterns file, cached in the
+ * cache directory of the options if any.
+ */
 MultipolygonGeo query_osm_search_area(const std::filesystem::path & input_file,
-        const std::filesystem::path & search_area_pattern_file);
+        const std::filesystem::path & search_area_pattern_file,
+        const QueryOptions & options = QueryOptions{});
 
 BGDumpHandler query_osm(const std::filesystem::path & input_file,
-        const std::filesystem::path & patterns_file, 
-        const MultipolygonGeo & search_area);
+        const std::filesystem::path & patterns_file,
+        const MultipolygonGeo & search_area,
+        const QueryOptions & options = QueryOptions{},
+        std::shared_ptr<IO::FeatureSink> sink = nullptr);
+
+/**
+ * Queries the entities of every region of the router in a single pass, the
+ * matched features are sent to the router.
+ */
+BGDumpHandler query_osm_regions(const std::filesystem::path & input_file,
+        const std::filesystem::path & patterns_file,
+        std::shared_ptr<IO::RegionsRouter> regions,
+        const QueryOptions & options = QueryOptions{});
+
+/**
+ * Queries the entities matching each patterns file in a single pass, the
+ * matched features of the i-th patterns file are sent to the i-th sink if
+ * any. Returns the handlers in the order of the patterns files.
+ */
+std::vector<BGDumpHandler> query_osm_batch(
+        const std::filesystem::path & input_file,
+        const std::vector<std::filesystem::path> & patterns_files,
+        const MultipolygonGeo & search_area,
+        const QueryOptions & options = QueryOptions{},
+        const std::vector<std::shared_ptr<IO::FeatureSink>> & sinks = {});
 
-#endif // QUERY_OSM_FILE_HPP
\ No newline at end of file
+#endif // QUERY_OSM_FILE_HPP
@@ -0,0 +1,177 @@
+#ifndef RULES_INDEX_HPP
+#define RULES_INDEX_HPP
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <osmium/util/string_matcher.hpp>
+
+#include "key_prefilter.hpp"
+
+/**
+ * @brief Hash map from strings to T that can be queried with string views
+ * without building a std::string.
+ */
+template <typename T>
+class StringMap {
+private:
+    std::unordered_multimap<std::size_t, std::pair<std::string, T>> map;
+
+public:
+    T * find(std::string_view key) noexcept {
+        auto [first, last] =
+            map.equal_range(std::hash<std::string_view>{}(key));
+        for(; first != last; ++first)
+            if(first->second.first == key) return &first->second.second;
+        return nullptr;
+    }
+
+    T & operator[](std::string_view key) {
+        if(T * value = find(key)) return *value;
+        return map
+            .emplace(std::hash<std::string_view>{}(key),
+                     std::make_pair(std::string(key), T{}))
+            ->second.second;
+    }
+
+    std::size_t size() const noexcept { return map.size(); }
+};
+
+/**
+ * @brief Ordered list of tags rules compiled into an index that finds the
+ * first rule matching a tag list without testing every rule.
+ *
+ * Each rule is indexed by its first key. For a given tag list, only the
+ * rules indexed by one of its keys and whose matcher for that key accepts
+ * the tag value are tested, in order. The candidate rules of a key/value
+ * pair are cached since the values of the indexed keys (landuse, natural,
+ * waterway, ...) are few.
+ *
+ * @tparam Builder The builder associated to each rule.
+ */
+template <typename Builder>
+class RulesIndex {
+public:
+    using Filter = std::vector<std::pair<std::string, osmium::StringMatcher>>;
+    using Rule = std::pair<Filter, Builder>;
+
+private:
+    // maximum number of cached values per key, it bounds the memory of keys
+    // with unbounded values, such as "name"
+    static constexpr std::size_t max_cached_values = 4096;
+
+    struct KeyRules {
+        std::vector<std::size_t> rules;
+        StringMap<std::vector<std::size_t>> value_rules;
+    };
+
+    std::vector<Rule> rules;
+    StringMap<KeyRules> key_rules;
+    std::vector<std::size_t> uncached_rules;
+    KeyPrefilter key_prefilter;
+
+    void index_rule(std::size_t rule_index) {
+        Filter & filter = rules[rule_index].first;
+        std::stable_sort(filter.begin(), filter.end(),
+                         [](const auto & p1, const auto & p2) {
+                             return p1.first < p2.first;
+                         });
+        key_rules[filter.front().first].rules.push_back(rule_index);
+    }
+
+    const std::vector<std::size_t> & candidate_rules(KeyRules & indexed,
+                                                     std::string_view value) {
+        if(std::vector<std::size_t> * cached = indexed.value_rules.find(value))
+            return *cached;
+        std::vector<std::size_t> & candidates =
+            indexed.value_rules.size() < max_cached_values
+                ? indexed.value_rules[value]
+                : uncached_rules;
+        candidates.clear();
+        std::copy_if(indexed.rules.cbegin(), indexed.rules.cend(),
+                     std::back_inserter(candidates), [&](std::size_t i) {
+                         return rules[i].first.front().second(value.data());
+                     });
+        return candidates;
+    }
+
+public:
+    explicit RulesIndex(std::vector<Rule> p_rules = {})
+        : rules(std::move(p_rules)) {
+        for(std::size_t i = 0; i < rules.size(); ++i) index_rule(i);
+        // a rule can only match tags that contain its indexed key
+        std::vector<std::string> indexed_keys;
+        for(const Rule & rule : rules)
+            indexed_keys.push_back(rule.first.front().first);
+        key_prefilter = KeyPrefilter(indexed_keys);
+    }
+
+    template <typename... RuleArgs>
+    void add_rule(RuleArgs &&... args) {
+        // rebuild the index since the cached candidates ignore the new rule
+        std::vector<Rule> new_rules = std::move(rules);
+        new_rules.emplace_back(std::forward<RuleArgs>(args)...);
+        *this = RulesIndex(std::move(new_rules));
+    }
+
+    const std::vector<Rule> & getRules() const noexcept { return rules; }
+    bool empty() const noexcept { return rules.empty(); }
+
+    /**
+     * Tests, without allocating, if the tags have a key indexed by a rule.
+     * The tags rejected by this test match no rule.
+     */
+    template <typename Tags>
+    bool may_match(const Tags & tags) const noexcept {
+        return key_prefilter.may_match(tags);
+    }
+
+    /**
+     * Tests if the tags, sorted by key, match every tag matcher of the filter,
+     * sorted by key.
+     */
+    template <typename Tags>
+    static bool fusion_test(Tags && tags, const Filter & filter) {
+        auto tags_first = tags.cbegin();
+        auto tags_last = tags.cend();
+        auto filter_first = filter.cbegin();
+        auto filter_last = filter.cend();
+        while(tags_first != tags_last && filter_first != filter_last) {
+            int r_cmp = tags_first->first.compare(filter_first->first);
+            if(r_cmp < 0) {
+                ++tags_first;
+                continue;
+            }
+            if(r_cmp > 0) return false;
+            if(!filter_first->second(tags_first->second.data())) return false;
+            ++tags_first;
+            ++filter_first;
+        }
+        return filter_first == filter_last;
+    }
+
+    /**
+     * Returns the first rule matching the tags, sorted by key, or nullptr.
+     */
+    template <typename Tags>
+    const Rule * find(Tags && tags) {
+        std::size_t best = rules.size();
+        for(const auto & [key, value] : tags) {
+            KeyRules * indexed_rules = key_rules.find(key);
+            if(indexed_rules == nullptr) continue;
+            for(std::size_t i : candidate_rules(*indexed_rules, value)) {
+                if(i >= best) break;
+                if(!fusion_test(tags, rules[i].first)) continue;
+                best = i;
+                break;
+            }
+        }
+        return best < rules.size() ? &rules[best] : nullptr;
+    }
+};
+
+#endif  // RULES_INDEX_HPP
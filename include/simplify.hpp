@@ -0,0 +1,230 @@
+#ifndef SIMPLIFY_HPP
+#define SIMPLIFY_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/geometry.hpp>
+
+#include "bg_types.hpp"
+#include "bg_validation.hpp"
+
+enum class SimplifyMethod { douglas_peucker, visvalingam };
+
+inline SimplifyMethod simplify_method_from_string(const std::string & name) {
+    if(name == "douglas-peucker") return SimplifyMethod::douglas_peucker;
+    if(name == "visvalingam") return SimplifyMethod::visvalingam;
+    throw std::invalid_argument("unknown simplification method " + name);
+}
+
+struct SimplifyOptions {
+    // tolerance, in meters, of the simplification of the ways and areas
+    // whose pattern does not set one, 0 for no simplification
+    double tolerance = 0;
+    SimplifyMethod method = SimplifyMethod::douglas_peucker;
+    // number of decimals, at most 17, the coordinates are rounded to, -1
+    // for none
+    int precision = -1;
+};
+
+namespace detail {
+/**
+ * @brief Equirectangular projection in meters around a point, accurate
+ * enough to compare distances to a tolerance within a geometry.
+ */
+class LocalProjection {
+private:
+    static constexpr double meters_per_degree = 6371008.8 * M_PI / 180;
+    double lon0, lat0, kx;
+
+public:
+    explicit LocalProjection(const BoxGeo & envelope)
+        : lon0((envelope.min_corner().x() + envelope.max_corner().x()) / 2)
+        , lat0((envelope.min_corner().y() + envelope.max_corner().y()) / 2)
+        , kx(meters_per_degree * std::cos(lat0 * M_PI / 180)) {}
+
+    Point2D forward(const PointGeo & p) const {
+        return Point2D((p.x() - lon0) * kx,
+                       (p.y() - lat0) * meters_per_degree);
+    }
+    PointGeo inverse(const Point2D & p) const {
+        return PointGeo(lon0 + p.x() / kx, lat0 + p.y() / meters_per_degree);
+    }
+};
+
+// Visvalingam-Whyatt simplification, removes the points whose effective
+// triangle area is below min_area, the end points are kept
+inline Linestring2D visvalingam(const Linestring2D & l, double min_area) {
+    const std::size_t n = l.size();
+    if(n < 3) return l;
+    auto triangle_area = [&l](std::size_t a, std::size_t b, std::size_t c) {
+        return std::abs((l[b].x() - l[a].x()) * (l[c].y() - l[a].y()) -
+                        (l[c].x() - l[a].x()) * (l[b].y() - l[a].y())) /
+               2;
+    };
+    std::vector<std::size_t> prev(n), next(n);
+    std::vector<double> area(n, std::numeric_limits<double>::infinity());
+    using Entry = std::pair<double, std::size_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+    for(std::size_t i = 0; i < n; ++i) {
+        prev[i] = i - 1;
+        next[i] = i + 1;
+    }
+    for(std::size_t i = 1; i + 1 < n; ++i) {
+        area[i] = triangle_area(i - 1, i, i + 1);
+        heap.emplace(area[i], i);
+    }
+    std::vector<bool> removed(n, false);
+    double max_removed_area = 0;
+    while(!heap.empty()) {
+        const auto [a, i] = heap.top();
+        heap.pop();
+        // skips the outdated entries
+        if(removed[i] || a != area[i]) continue;
+        // the effective area of a point is at least the one of the points
+        // removed before it
+        max_removed_area = std::max(max_removed_area, a);
+        if(max_removed_area >= min_area) break;
+        removed[i] = true;
+        next[prev[i]] = next[i];
+        prev[next[i]] = prev[i];
+        for(const std::size_t j : {prev[i], next[i]}) {
+            if(j == 0 || j == n - 1) continue;
+            area[j] = triangle_area(prev[j], j, next[j]);
+            heap.emplace(area[j], j);
+        }
+    }
+    Linestring2D simplified;
+    for(std::size_t i = 0; i < n; i = next[i]) simplified.push_back(l[i]);
+    return simplified;
+}
+}  // namespace detail
+
+/**
+ * @brief Simplifies the geometries with a tolerance in meters and rounds
+ * their coordinates to a given number of decimals, removing the points that
+ * become duplicates.
+ *
+ * The polygons are simplified with halved tolerances until they pass the
+ * checks of the validation mode, the rings collapsing under the tolerance
+ * are dropped.
+ */
+class GeometrySimplifier {
+private:
+    SimplifyOptions options;
+    double scale;
+    ValidationMode validation;
+
+    // checks the simplified areas as the built ones are
+    bool check(const MultipolygonGeo & mp) const {
+        switch(validation) {
+            case ValidationMode::none:
+                return true;
+            case ValidationMode::fast:
+                return fast_check_multipolygon(mp) == GeometryError::none;
+            default:
+                return boost::geometry::is_valid(mp);
+        }
+    }
+
+    PointGeo quantize(const PointGeo & p) const {
+        if(options.precision < 0) return p;
+        return PointGeo(std::round(p.x() * scale) / scale,
+                        std::round(p.y() * scale) / scale);
+    }
+
+    template <typename Points>
+    Points simplify_points(const Points & points, double tolerance,
+                           const detail::LocalProjection & projection) const {
+        Points simplified;
+        if(tolerance > 0) {
+            Linestring2D projected;
+            projected.reserve(points.size());
+            for(const PointGeo & p : points)
+                projected.push_back(projection.forward(p));
+            Linestring2D kept;
+            if(options.method == SimplifyMethod::visvalingam)
+                kept = detail::visvalingam(projected, tolerance * tolerance);
+            else
+                boost::geometry::simplify(projected, kept, tolerance);
+            for(const Point2D & p : kept)
+                simplified.push_back(quantize(projection.inverse(p)));
+        } else {
+            for(const PointGeo & p : points) simplified.push_back(quantize(p));
+        }
+        boost::geometry::unique(simplified);
+        return simplified;
+    }
+
+    MultipolygonGeo simplify_multipolygon(
+        const MultipolygonGeo & mp, double tolerance,
+        const detail::LocalProjection & projection) const {
+        MultipolygonGeo simplified;
+        for(const PolygonGeo & polygon : mp) {
+            PolygonGeo p;
+            p.outer() = simplify_points(polygon.outer(), tolerance, projection);
+            if(p.outer().size() < 4) continue;
+            for(const RingGeo & inner : polygon.inners()) {
+                RingGeo ring = simplify_points(inner, tolerance, projection);
+                if(ring.size() >= 4) p.inners().push_back(std::move(ring));
+            }
+            simplified.push_back(std::move(p));
+        }
+        return simplified;
+    }
+
+public:
+    explicit GeometrySimplifier(
+        SimplifyOptions p_options = SimplifyOptions{},
+        ValidationMode p_validation = ValidationMode::full)
+        : options(p_options)
+        , scale(std::pow(10.0, std::max(options.precision, 0)))
+        , validation(p_validation) {}
+
+    void setValidation(ValidationMode mode) noexcept { validation = mode; }
+
+    double getTolerance() const noexcept { return options.tolerance; }
+    bool isActive(double tolerance) const noexcept {
+        return tolerance > 0 || options.precision >= 0;
+    }
+
+    /**
+     * Returns false if the linestring collapses to a single point.
+     */
+    bool simplify(LinestringGeo & l, double tolerance) const {
+        const detail::LocalProjection projection(
+            boost::geometry::return_envelope<BoxGeo>(l));
+        l = simplify_points(l, tolerance, projection);
+        return l.size() >= 2;
+    }
+
+    /**
+     * Returns false if every polygon collapses.
+     */
+    bool simplify(MultipolygonGeo & mp, double tolerance) const {
+        const detail::LocalProjection projection(
+            boost::geometry::return_envelope<BoxGeo>(mp));
+        // the rounding alone is not checked, like the rounding of the output
+        for(; tolerance > 0; tolerance /= 2) {
+            MultipolygonGeo simplified =
+                simplify_multipolygon(mp, tolerance, projection);
+            if(check(simplified)) {
+                mp = std::move(simplified);
+                return !mp.empty();
+            }
+            if(tolerance < 1) break;
+        }
+        mp = simplify_multipolygon(mp, 0, projection);
+        return !mp.empty();
+    }
+};
+
+#endif  // SIMPLIFY_HPP
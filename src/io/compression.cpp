@@ -0,0 +1,67 @@
+#include "io/compression.hpp"
+
+#include <memory>
+
+#include <zlib.h>
+#include <zstd.h>
+
+namespace IO {
+namespace {
+// compression levels of the gzip and zstd command line tools
+constexpr int gzip_level = 6;
+constexpr int zstd_level = 3;
+
+void gzip_block(std::string_view block, std::vector<char> & out) {
+    // reused by the thread for each of its blocks
+    struct Deflater {
+        z_stream stream{};
+        Deflater() {
+            // 16 + 15: gzip header and trailer with a 32 KiB window
+            if(deflateInit2(&stream, gzip_level, Z_DEFLATED, 16 + 15, 8,
+                            Z_DEFAULT_STRATEGY) != Z_OK)
+                throw std::runtime_error("cannot initialize zlib");
+        }
+        ~Deflater() { deflateEnd(&stream); }
+    };
+    thread_local Deflater deflater;
+    z_stream & stream = deflater.stream;
+    deflateReset(&stream);
+    out.resize(deflateBound(&stream, static_cast<uLong>(block.size())));
+    stream.next_in =
+        reinterpret_cast<Bytef *>(const_cast<char *>(block.data()));
+    stream.avail_in = static_cast<uInt>(block.size());
+    stream.next_out = reinterpret_cast<Bytef *>(out.data());
+    stream.avail_out = static_cast<uInt>(out.size());
+    if(deflate(&stream, Z_FINISH) != Z_STREAM_END)
+        throw std::runtime_error("gzip compression failed");
+    out.resize(stream.total_out);
+}
+
+void zstd_block(std::string_view block, std::vector<char> & out) {
+    thread_local std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> context(
+        ZSTD_createCCtx(), &ZSTD_freeCCtx);
+    out.resize(ZSTD_compressBound(block.size()));
+    const std::size_t size =
+        ZSTD_compressCCtx(context.get(), out.data(), out.size(),
+                          block.data(), block.size(), zstd_level);
+    if(ZSTD_isError(size))
+        throw std::runtime_error(std::string("zstd compression failed: ") +
+                                 ZSTD_getErrorName(size));
+    out.resize(size);
+}
+}  // namespace
+
+void compress_block(Compression compression, std::string_view block,
+                    std::vector<char> & out) {
+    switch(compression) {
+        case Compression::gzip:
+            gzip_block(block, out);
+            return;
+        case Compression::zstd:
+            zstd_block(block, out);
+            return;
+        default:
+            out.assign(block.begin(), block.end());
+    }
+}
+}  // namespace IO
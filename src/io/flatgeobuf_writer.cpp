@@ -0,0 +1,424 @@
+#include "io/flatgeobuf_writer.hpp"
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+
+namespace IO {
+namespace {
+constexpr std::uint8_t magic_bytes[8] = {'f', 'g', 'b', 3, 'f', 'g', 'b', 0};
+constexpr std::uint16_t index_node_size = 16;
+
+// values of the GeometryType and ColumnType enums of the FlatGeobuf schema
+enum GeometryType : std::uint8_t {
+    unknown = 0,
+    point = 1,
+    linestring = 2,
+    polygon = 3,
+    multipolygon = 6
+};
+constexpr std::uint8_t string_column = 11;
+
+// node of the packed R-tree, as laid out in the file
+struct NodeItem {
+    double min_x, min_y, max_x, max_y;
+    std::uint64_t offset;
+};
+static_assert(sizeof(NodeItem) == 40);
+
+std::ofstream open(const std::filesystem::path & path,
+                   std::ios::openmode mode) {
+    std::ofstream file(path, std::ios::binary | std::ios::out | mode);
+    if(!file)
+        throw std::runtime_error("cannot open " + path.string() +
+                                 " for writing");
+    return file;
+}
+
+template <typename Points>
+Box2D planar_envelope(const Points & points) {
+    Box2D box = boost::geometry::make_inverse<Box2D>();
+    for(const auto & p : points)
+        boost::geometry::expand(box, Point2D(p.x(), p.y()));
+    return box;
+}
+
+template <typename Points>
+void encode_xy(detail::FlatBufferBuilder & builder, std::size_t offset_pos,
+               const Points & points, std::vector<double> & xy) {
+    xy.clear();
+    for(const auto & p : points) {
+        xy.push_back(p.x());
+        xy.push_back(p.y());
+    }
+    builder.vector(offset_pos, xy.data(), xy.size());
+}
+
+// Geometry table: ends, xy, z, m, t, tm, type, parts
+void encode_polygon(detail::FlatBufferBuilder & builder,
+                    std::size_t offset_pos, const PolygonFixed & polygon) {
+    const bool has_inners = !polygon.inners().empty();
+    builder.startTable(offset_pos, 8);
+    const std::size_t ends_pos = has_inners ? builder.offsetField(0) : 0;
+    const std::size_t xy_pos = builder.offsetField(1);
+    builder.field<std::uint8_t>(6, GeometryType::polygon);
+    builder.endTable();
+    // the end of each ring, in points, only needed with several rings
+    if(has_inners) {
+        std::vector<std::uint32_t> ends;
+        std::uint32_t end = static_cast<std::uint32_t>(polygon.outer().size());
+        ends.push_back(end);
+        for(const RingFixed & inner : polygon.inners())
+            ends.push_back(end += static_cast<std::uint32_t>(inner.size()));
+        builder.vector(ends_pos, ends.data(), ends.size());
+    }
+    std::vector<double> xy;
+    xy.reserve(2 * boost::geometry::num_points(polygon));
+    for(const PointFixed & p : polygon.outer()) {
+        xy.push_back(p.x());
+        xy.push_back(p.y());
+    }
+    for(const RingFixed & inner : polygon.inners()) {
+        for(const PointFixed & p : inner) {
+            xy.push_back(p.x());
+            xy.push_back(p.y());
+        }
+    }
+    builder.vector(xy_pos, xy.data(), xy.size());
+}
+
+void encode_multipolygon(detail::FlatBufferBuilder & builder,
+                         std::size_t offset_pos, const MultipolygonFixed & mp) {
+    builder.startTable(offset_pos, 8);
+    builder.field<std::uint8_t>(6, GeometryType::multipolygon);
+    const std::size_t parts_pos = builder.offsetField(7);
+    builder.endTable();
+    const std::size_t first = builder.tablesVector(parts_pos, mp.size());
+    for(std::size_t i = 0; i < mp.size(); ++i)
+        encode_polygon(builder, first + 4 * i, mp[i]);
+}
+}  // namespace
+
+namespace detail {
+// from https://github.com/rawrunprotected/hilbert_curves (public domain)
+std::uint32_t hilbert(std::uint32_t x, std::uint32_t y) noexcept {
+    std::uint32_t a = x ^ y;
+    std::uint32_t b = 0xFFFF ^ a;
+    std::uint32_t c = 0xFFFF ^ (x | y);
+    std::uint32_t d = x & (y ^ 0xFFFF);
+
+    std::uint32_t A = a | (b >> 1);
+    std::uint32_t B = (a >> 1) ^ a;
+    std::uint32_t C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+    std::uint32_t D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
+
+    a = A;
+    b = B;
+    c = C;
+    d = D;
+    A = ((a & (a >> 2)) ^ (b & (b >> 2)));
+    B = ((a & (b >> 2)) ^ (b & ((a ^ b) >> 2)));
+    C ^= ((a & (c >> 2)) ^ (b & (d >> 2)));
+    D ^= ((b & (c >> 2)) ^ ((a ^ b) & (d >> 2)));
+
+    a = A;
+    b = B;
+    c = C;
+    d = D;
+    A = ((a & (a >> 4)) ^ (b & (b >> 4)));
+    B = ((a & (b >> 4)) ^ (b & ((a ^ b) >> 4)));
+    C ^= ((a & (c >> 4)) ^ (b & (d >> 4)));
+    D ^= ((b & (c >> 4)) ^ ((a ^ b) & (d >> 4)));
+
+    a = A;
+    b = B;
+    c = C;
+    d = D;
+    C ^= ((a & (c >> 8)) ^ (b & (d >> 8)));
+    D ^= ((b & (c >> 8)) ^ ((a ^ b) & (d >> 8)));
+
+    a = C ^ (C >> 1);
+    b = D ^ (D >> 1);
+
+    std::uint32_t i0 = x ^ y;
+    std::uint32_t i1 = b | (0xFFFF ^ (i0 | a));
+
+    i0 = (i0 | (i0 << 8)) & 0x00FF00FF;
+    i0 = (i0 | (i0 << 4)) & 0x0F0F0F0F;
+    i0 = (i0 | (i0 << 2)) & 0x33333333;
+    i0 = (i0 | (i0 << 1)) & 0x55555555;
+
+    i1 = (i1 | (i1 << 8)) & 0x00FF00FF;
+    i1 = (i1 | (i1 << 4)) & 0x0F0F0F0F;
+    i1 = (i1 | (i1 << 2)) & 0x33333333;
+    i1 = (i1 | (i1 << 1)) & 0x55555555;
+
+    return (i1 << 1) | i0;
+}
+}  // namespace detail
+
+FlatGeobufWriter::FlatGeobufWriter(const std::filesystem::path & fgb_file,
+                                   std::size_t p_buffer_size)
+    : path(fgb_file)
+    , features_path(fgb_file.string() + ".tmp")
+    , buffer_size(p_buffer_size)
+    , features_size(0)
+    , closed(false) {
+    // fails early if the output is not writable
+    open(path, std::ios::trunc);
+    open(features_path, std::ios::trunc);
+}
+
+FlatGeobufWriter::~FlatGeobufWriter() {
+    try {
+        close();
+    } catch(const std::exception & e) {
+        std::cerr << "Error: " << e.what() << "\n";
+    }
+    // left by a failed close
+    std::error_code error;
+    std::filesystem::remove(features_path, error);
+}
+
+std::uint16_t FlatGeobufWriter::column(LocalBuffer & buffer,
+                                       std::string_view name) {
+    auto it = buffer.columns.find(name);
+    if(it != buffer.columns.end()) return it->second;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto shared_it = columns.find(name);
+    if(shared_it == columns.end()) {
+        if(column_names.size() > std::numeric_limits<std::uint16_t>::max())
+            throw std::runtime_error("more than 65536 property names in " +
+                                     path.string());
+        const std::string & column_name = column_names.emplace_back(name);
+        shared_it =
+            columns
+                .emplace(column_name,
+                         static_cast<std::uint16_t>(column_names.size() - 1))
+                .first;
+    }
+    buffer.columns.emplace(shared_it->first, shared_it->second);
+    return shared_it->second;
+}
+
+// each property is its column index followed by its length and bytes
+void FlatGeobufWriter::encodeProperties(LocalBuffer & buffer,
+                                        detail::FlatBufferBuilder & builder,
+                                        std::size_t offset_pos,
+                                        const Properties & properties) {
+    std::vector<std::uint8_t> & bytes = buffer.properties;
+    bytes.clear();
+    auto append = [&bytes](auto value) {
+        const auto * first = reinterpret_cast<const std::uint8_t *>(&value);
+        bytes.insert(bytes.end(), first, first + sizeof(value));
+    };
+    for(const auto & [key, value] : properties) {
+        append(column(buffer, key));
+        append(static_cast<std::uint32_t>(value.size()));
+        bytes.insert(bytes.end(), value.begin(), value.end());
+    }
+    builder.vector(offset_pos, bytes.data(), bytes.size());
+}
+
+void FlatGeobufWriter::flush(LocalBuffer & buffer) {
+    if(buffer.entries.empty()) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    open(features_path, std::ios::app)
+        .write(reinterpret_cast<const char *>(buffer.bytes.data()),
+               static_cast<std::streamsize>(buffer.bytes.size()));
+    for(Entry & entry : buffer.entries) {
+        entry.offset += features_size;
+        entries.push_back(entry);
+    }
+    features_size += buffer.bytes.size();
+    buffer.bytes.clear();
+    buffer.entries.clear();
+}
+
+void FlatGeobufWriter::write(const Node & node) {
+    const Box2D box(Point2D(node.point.x(), node.point.y()),
+                    Point2D(node.point.x(), node.point.y()));
+    encode(node, box,
+           [&node](detail::FlatBufferBuilder & builder, std::size_t pos) {
+               const double xy[2] = {node.point.x(), node.point.y()};
+               builder.startTable(pos, 8);
+               const std::size_t xy_pos = builder.offsetField(1);
+               builder.field<std::uint8_t>(6, GeometryType::point);
+               builder.endTable();
+               builder.vector(xy_pos, xy, 2);
+           });
+}
+
+void FlatGeobufWriter::write(const Way & way) {
+    encode(way, planar_envelope(way.linestring),
+           [&way](detail::FlatBufferBuilder & builder, std::size_t pos) {
+               std::vector<double> xy;
+               builder.startTable(pos, 8);
+               const std::size_t xy_pos = builder.offsetField(1);
+               builder.field<std::uint8_t>(6, GeometryType::linestring);
+               builder.endTable();
+               encode_xy(builder, xy_pos, way.linestring, xy);
+           });
+}
+
+void FlatGeobufWriter::write(const Area & area) {
+    Box2D box = boost::geometry::make_inverse<Box2D>();
+    for(const PolygonFixed & polygon : area.multipolygon)
+        boost::geometry::expand(box, planar_envelope(polygon.outer()));
+    encode(area, box,
+           [&area](detail::FlatBufferBuilder & builder, std::size_t pos) {
+               encode_multipolygon(builder, pos, area.multipolygon);
+           });
+}
+
+void FlatGeobufWriter::close() {
+    if(closed) return;
+    closed = true;
+    buffers.combine_each([this](LocalBuffer & buffer) { flush(buffer); });
+
+    const std::size_t nb_features = entries.size();
+    Box2D extent = boost::geometry::make_inverse<Box2D>();
+    for(const Entry & e : entries) {
+        boost::geometry::expand(extent, Point2D(e.min_x, e.min_y));
+        boost::geometry::expand(extent, Point2D(e.max_x, e.max_y));
+    }
+
+    // sorts the features along the Hilbert curve of the extent
+    const double width = extent.max_corner().x() - extent.min_corner().x();
+    const double height = extent.max_corner().y() - extent.min_corner().y();
+    constexpr double hilbert_max = (1 << 16) - 1;
+    auto grid = [](double v, double min, double size) {
+        if(size <= 0) return std::uint32_t{0};
+        return static_cast<std::uint32_t>(
+            std::floor(hilbert_max * (v - min) / size));
+    };
+    std::vector<std::pair<std::uint32_t, std::size_t>> order;
+    order.reserve(nb_features);
+    for(std::size_t i = 0; i < nb_features; ++i) {
+        const Entry & e = entries[i];
+        order.emplace_back(
+            detail::hilbert(grid((e.min_x + e.max_x) / 2,
+                                 extent.min_corner().x(), width),
+                            grid((e.min_y + e.max_y) / 2,
+                                 extent.min_corner().y(), height)),
+            i);
+    }
+    std::sort(order.begin(), order.end());
+
+    // packed R-tree, the levels are stored from the root to the leaves and
+    // each node points to the feature offset or to its first child
+    std::vector<NodeItem> nodes;
+    if(nb_features > 0) {
+        std::vector<std::size_t> level_sizes{nb_features};
+        std::size_t nb_nodes = nb_features;
+        // a single feature still has a root above its leaf
+        std::size_t n = nb_features;
+        do {
+            n = (n + index_node_size - 1) / index_node_size;
+            level_sizes.push_back(n);
+            nb_nodes += n;
+        } while(n != 1);
+        nodes.resize(nb_nodes);
+        std::size_t level_end = nb_nodes;
+        std::vector<std::size_t> level_offsets;
+        for(const std::size_t size : level_sizes)
+            level_offsets.push_back(level_end -= size);
+
+        std::uint64_t offset = 0;
+        for(std::size_t i = 0; i < nb_features; ++i) {
+            const Entry & e = entries[order[i].second];
+            nodes[level_offsets[0] + i] = {e.min_x, e.min_y, e.max_x, e.max_y,
+                                           offset};
+            offset += e.size;
+        }
+        for(std::size_t level = 0; level + 1 < level_sizes.size(); ++level) {
+            std::size_t pos = level_offsets[level];
+            const std::size_t end = pos + level_sizes[level];
+            std::size_t parent = level_offsets[level + 1];
+            while(pos < end) {
+                NodeItem node{std::numeric_limits<double>::infinity(),
+                              std::numeric_limits<double>::infinity(),
+                              -std::numeric_limits<double>::infinity(),
+                              -std::numeric_limits<double>::infinity(), pos};
+                for(std::size_t j = 0; j < index_node_size && pos < end;
+                    ++j, ++pos) {
+                    node.min_x = std::min(node.min_x, nodes[pos].min_x);
+                    node.min_y = std::min(node.min_y, nodes[pos].min_y);
+                    node.max_x = std::max(node.max_x, nodes[pos].max_x);
+                    node.max_y = std::max(node.max_y, nodes[pos].max_y);
+                }
+                nodes[parent++] = node;
+            }
+        }
+    }
+
+    // Header table: name, envelope, geometry_type, has_z, has_m, has_t,
+    // has_tm, columns, features_count, index_node_size, crs
+    std::vector<std::uint8_t> header;
+    detail::FlatBufferBuilder builder(header);
+    builder.startRoot(11);
+    const std::size_t name_pos = builder.offsetField(0);
+    const std::size_t envelope_pos =
+        nb_features > 0 ? builder.offsetField(1) : 0;
+    builder.field<std::uint8_t>(2, GeometryType::unknown);
+    const std::size_t columns_pos =
+        column_names.empty() ? 0 : builder.offsetField(7);
+    builder.field<std::uint64_t>(8, nb_features);
+    builder.field<std::uint16_t>(9, nb_features > 0 ? index_node_size : 0);
+    const std::size_t crs_pos = builder.offsetField(10);
+    builder.endTable();
+    builder.string(name_pos, path.stem().string());
+    if(nb_features > 0) {
+        const double envelope[4] = {
+            extent.min_corner().x(), extent.min_corner().y(),
+            extent.max_corner().x(), extent.max_corner().y()};
+        builder.vector(envelope_pos, envelope, 4);
+    }
+    if(!column_names.empty()) {
+        const std::size_t first =
+            builder.tablesVector(columns_pos, column_names.size());
+        for(std::size_t i = 0; i < column_names.size(); ++i) {
+            // Column table: name, type
+            builder.startTable(first + 4 * i, 2);
+            const std::size_t column_name_pos = builder.offsetField(0);
+            builder.field<std::uint8_t>(1, string_column);
+            builder.endTable();
+            builder.string(column_name_pos, column_names[i]);
+        }
+    }
+    // Crs table: org, code
+    builder.startTable(crs_pos, 2);
+    const std::size_t org_pos = builder.offsetField(0);
+    builder.field<std::int32_t>(1, 4326);
+    builder.endTable();
+    builder.string(org_pos, "EPSG");
+    builder.finish();
+
+    std::ofstream fgb = open(path, std::ios::trunc);
+    fgb.write(reinterpret_cast<const char *>(magic_bytes), 8);
+    fgb.write(reinterpret_cast<const char *>(header.data()),
+              static_cast<std::streamsize>(header.size()));
+    fgb.write(reinterpret_cast<const char *>(nodes.data()),
+              static_cast<std::streamsize>(nodes.size() * sizeof(NodeItem)));
+    std::ifstream features(features_path, std::ios::binary);
+    std::vector<char> feature;
+    for(const auto & [h, i] : order) {
+        const Entry & e = entries[i];
+        feature.resize(e.size);
+        features.seekg(static_cast<std::streamoff>(e.offset));
+        features.read(feature.data(), e.size);
+        if(!features)
+            throw std::runtime_error("failed to read " +
+                                     features_path.string());
+        fgb.write(feature.data(), e.size);
+    }
+    if(!fgb)
+        throw std::runtime_error("failed to write " + path.string());
+    features.close();
+    std::filesystem::remove(features_path);
+    entries.clear();
+}
+}  // namespace IO
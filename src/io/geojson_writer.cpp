@@ -0,0 +1,79 @@
+#include "io/geojson_writer.hpp"
+
+#include <iostream>
+
+namespace IO {
+GeoJSONWriter::GeoJSONWriter(const std::filesystem::path & json_file,
+                             int precision, std::size_t p_buffer_size,
+                             Compression p_compression)
+    : path(json_file)
+    , buffer_size(p_buffer_size)
+    , empty(true)
+    , closed(false)
+    , compression(p_compression)
+    // the buffers start small and grow up to the buffer size, thus the
+    // threads writing few features, as to some of many regions, hold little
+    , serializers([precision] { return GeoJSONSerializer(precision); }) {
+    writeBlock("{\"type\":\"FeatureCollection\",\"features\":[",
+               std::ios::trunc);
+}
+
+// the errors of an explicit close() are thrown, those on destruction logged
+GeoJSONWriter::~GeoJSONWriter() {
+    try {
+        close();
+    } catch(const std::exception & e) {
+        std::cerr << "Error: " << e.what() << "\n";
+    }
+}
+
+std::ofstream GeoJSONWriter::open(std::ios::openmode mode) {
+    std::ofstream json(path, std::ios::binary | std::ios::out | mode);
+    if(!json)
+        throw std::runtime_error("cannot open " + path.string() +
+                                 " for writing");
+    return json;
+}
+
+std::string_view GeoJSONWriter::compress(
+    std::string_view block, std::vector<char> & compressed) const {
+    if(compression == Compression::none) return block;
+    compress_block(compression, block, compressed);
+    return std::string_view(compressed.data(), compressed.size());
+}
+
+void GeoJSONWriter::writeBlock(std::string_view block,
+                               std::ios::openmode mode) {
+    std::vector<char> compressed;
+    block = compress(block, compressed);
+    open(mode).write(block.data(), static_cast<std::streamsize>(block.size()));
+}
+
+void GeoJSONWriter::flush(GeoJSONSerializer & serializer) {
+    if(serializer.empty()) return;
+    std::unique_lock<std::mutex> lock(mutex);
+    // every feature is preceded by a separator, except the first one
+    const std::size_t skip = empty ? 1 : 0;
+    std::string_view block(serializer.buffer() + skip,
+                           serializer.size() - skip);
+    // the blocks are compressed in parallel, except the first one that
+    // must be appended before the others
+    std::vector<char> compressed;
+    if(compression != Compression::none && !empty) lock.unlock();
+    block = compress(block, compressed);
+    if(!lock.owns_lock()) lock.lock();
+    open(std::ios::app)
+        .write(block.data(), static_cast<std::streamsize>(block.size()));
+    empty = false;
+    serializer.clear();
+}
+
+void GeoJSONWriter::close() {
+    // not retried if it throws
+    if(closed) return;
+    closed = true;
+    serializers.combine_each(
+        [this](GeoJSONSerializer & serializer) { flush(serializer); });
+    writeBlock("]}", std::ios::app);
+}
+}  // namespace IO
@@ -0,0 +1,572 @@
+#include "io/mvt_writer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string_view>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+
+#include <nlohmann/json.hpp>
+
+#include <protozero/pbf_writer.hpp>
+#include <protozero/varint.hpp>
+
+namespace IO {
+namespace {
+using WorldMultipolygon = MVTWriter::WorldMultipolygon;
+using TilePoint = std::pair<std::int32_t, std::int32_t>;
+
+constexpr double max_latitude = 85.05112877980659;
+
+template <typename Point>
+Point2D to_world(const Point & p) {
+    const double lat = std::clamp(p.y(), -max_latitude, max_latitude);
+    const double sin_lat = std::sin(lat * M_PI / 180);
+    return Point2D(
+        (p.x() + 180) / 360,
+        0.5 - std::log((1 + sin_lat) / (1 - sin_lat)) / (4 * M_PI));
+}
+
+PointGeo to_geo(const Point2D & p) {
+    return PointGeo(
+        p.x() * 360 - 180,
+        std::atan(std::sinh(M_PI * (1 - 2 * p.y()))) * 180 / M_PI);
+}
+
+// MVT geometry commands
+enum Command : std::uint32_t { move_to = 1, line_to = 2, close_path = 7 };
+// MVT geometry types
+enum GeomType : std::uint32_t { point = 1, linestring = 2, polygon = 3 };
+
+std::uint32_t command(Command id, std::size_t count) {
+    return static_cast<std::uint32_t>(id) |
+           static_cast<std::uint32_t>(count << 3);
+}
+
+// area of the ring times two, positive for the rings clockwise on screen
+std::int64_t shoelace(const std::vector<TilePoint> & ring) {
+    std::int64_t sum = 0;
+    for(std::size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++)
+        sum += static_cast<std::int64_t>(ring[j].first) * ring[i].second -
+               static_cast<std::int64_t>(ring[i].first) * ring[j].second;
+    return sum;
+}
+
+/**
+ * Converts the clipped world geometries to the integer coordinates of a
+ * tile and appends their commands.
+ */
+class TileGeometryEncoder {
+private:
+    double scale, x0, y0;
+    TilePoint cursor;
+    std::vector<TilePoint> points;
+
+    TilePoint to_tile(const Point2D & p) const {
+        return TilePoint(
+            static_cast<std::int32_t>(std::lround((p.x() - x0) * scale)),
+            static_cast<std::int32_t>(std::lround((p.y() - y0) * scale)));
+    }
+
+    template <typename Points>
+    void convert(const Points & world_points) {
+        points.clear();
+        for(const Point2D & p : world_points) {
+            const TilePoint t = to_tile(p);
+            if(points.empty() || points.back() != t) points.push_back(t);
+        }
+    }
+
+    void encode_points(std::vector<std::uint32_t> & geometry,
+                       std::size_t first, std::size_t last) {
+        for(std::size_t i = first; i < last; ++i) {
+            geometry.push_back(
+                protozero::encode_zigzag32(points[i].first - cursor.first));
+            geometry.push_back(
+                protozero::encode_zigzag32(points[i].second - cursor.second));
+            cursor = points[i];
+        }
+    }
+    void encode_path(std::vector<std::uint32_t> & geometry) {
+        geometry.push_back(command(move_to, 1));
+        encode_points(geometry, 0, 1);
+        geometry.push_back(command(line_to, points.size() - 1));
+        encode_points(geometry, 1, points.size());
+    }
+
+    // returns false if the ring collapses or is reversed by the rounding
+    template <typename Ring>
+    bool encode_ring(std::vector<std::uint32_t> & geometry, const Ring & ring,
+                     bool outer) {
+        convert(ring);
+        if(points.size() > 1 && points.front() == points.back())
+            points.pop_back();
+        if(points.size() < 3) return false;
+        const std::int64_t area = shoelace(points);
+        if(outer ? area <= 0 : area >= 0) return false;
+        encode_path(geometry);
+        geometry.push_back(command(close_path, 1));
+        return true;
+    }
+
+public:
+    TileGeometryEncoder(int z, std::uint32_t x, std::uint32_t y)
+        : scale(std::ldexp(static_cast<double>(MVTWriter::extent), z))
+        , x0(std::ldexp(static_cast<double>(x), -z))
+        , y0(std::ldexp(static_cast<double>(y), -z))
+        , cursor(0, 0) {}
+
+    void reset() noexcept { cursor = TilePoint(0, 0); }
+
+    void encode(std::vector<std::uint32_t> & geometry, const Point2D & p) {
+        points.assign(1, to_tile(p));
+        geometry.push_back(command(move_to, 1));
+        encode_points(geometry, 0, 1);
+    }
+
+    void encode(std::vector<std::uint32_t> & geometry,
+                const Linestring2D & l) {
+        convert(l);
+        if(points.size() >= 2) encode_path(geometry);
+    }
+
+    void encode(std::vector<std::uint32_t> & geometry,
+                const WorldMultipolygon & mp) {
+        for(const auto & polygon : mp) {
+            if(!encode_ring(geometry, polygon.outer(), true)) continue;
+            for(const auto & inner : polygon.inners())
+                encode_ring(geometry, inner, false);
+        }
+    }
+};
+
+// encoded feature of a tile
+struct TileFeature {
+    GeomType type;
+    std::vector<std::uint32_t> tags;
+    std::vector<std::uint32_t> geometry;
+};
+
+/**
+ * Builds the single layer tile of the given features, returns an empty
+ * string if none remains after clipping.
+ */
+class TileBuilder {
+private:
+    std::vector<TileFeature> features;
+    // views of the properties of the features, alive until the tiles are
+    std::vector<std::string_view> keys;
+    std::vector<std::string_view> values;
+    std::unordered_map<std::string_view, std::uint32_t> key_indices;
+    std::unordered_map<std::string_view, std::uint32_t> value_indices;
+
+    static std::uint32_t index(
+        std::string_view s, std::vector<std::string_view> & strings,
+        std::unordered_map<std::string_view, std::uint32_t> & indices) {
+        auto [it, inserted] = indices.try_emplace(
+            s, static_cast<std::uint32_t>(strings.size()));
+        if(inserted) strings.push_back(s);
+        return it->second;
+    }
+
+    void write_layer(protozero::pbf_writer & tile,
+                     const std::string & layer_name) const {
+        protozero::pbf_writer layer(tile, 3);
+        layer.add_uint32(15, 2);  // version
+        layer.add_string(1, layer_name);
+        for(const TileFeature & feature : features) {
+            protozero::pbf_writer f(layer, 2);
+            {
+                protozero::packed_field_uint32 tags(f, 2);
+                for(const std::uint32_t tag : feature.tags)
+                    tags.add_element(tag);
+            }
+            f.add_uint32(3, feature.type);
+            protozero::packed_field_uint32 geometry(f, 4);
+            for(const std::uint32_t g : feature.geometry)
+                geometry.add_element(g);
+        }
+        for(const std::string_view key : keys)
+            layer.add_string(3, key.data(), key.size());
+        for(const std::string_view value : values) {
+            protozero::pbf_writer v(layer, 4);
+            v.add_string(1, value.data(), value.size());  // string_value
+        }
+        layer.add_uint32(5, MVTWriter::extent);
+    }
+
+public:
+    std::vector<std::uint32_t> & add(GeomType type,
+                                     const Properties & properties) {
+        TileFeature & feature = features.emplace_back();
+        feature.type = type;
+        for(const auto & [key, value] : properties) {
+            feature.tags.push_back(index(key, keys, key_indices));
+            feature.tags.push_back(index(value, values, value_indices));
+        }
+        return feature.geometry;
+    }
+    // drops the last feature if it has no geometry
+    void commit() {
+        if(features.back().geometry.empty()) features.pop_back();
+    }
+
+    std::string build(const std::string & layer_name) const {
+        std::string data;
+        if(features.empty()) return data;
+        protozero::pbf_writer tile(data);
+        write_layer(tile, layer_name);
+        return data;
+    }
+};
+
+// part of a feature inside the buffered box of a tile, the whole feature
+// while it is not clipped, shared by the tiles that do not clip it further
+template <typename Clipped>
+struct TilePart {
+    std::size_t feature;
+    std::shared_ptr<const Clipped> clipped;
+    Box2D box;
+};
+
+using MultiLinestring2D =
+    boost::geometry::model::multi_linestring<Linestring2D>;
+
+struct TileParts {
+    std::vector<std::size_t> points;
+    std::vector<TilePart<MultiLinestring2D>> lines;
+    std::vector<TilePart<WorldMultipolygon>> areas;
+    // areas covering the whole buffered box of the tile
+    std::vector<std::size_t> covering_areas;
+
+    bool empty() const noexcept {
+        return points.empty() && lines.empty() && areas.empty() &&
+               covering_areas.empty();
+    }
+};
+
+/**
+ * Writes the tiles of the features from the zoom level 0 down, each tile
+ * clipping the parts of the features inside its parent tile, so that every
+ * zoom level clips about once each feature.
+ */
+class TilePyramid {
+private:
+    const MVTWriter::Features & all;
+    const std::filesystem::path & directory;
+    const std::string & layer_name;
+    const MVTOptions & options;
+
+    static Box2D clip_box(unsigned z, std::uint32_t x, std::uint32_t y) {
+        const double nb_tiles = std::ldexp(1.0, static_cast<int>(z));
+        const double margin =
+            static_cast<double>(MVTWriter::buffer) / MVTWriter::extent;
+        return Box2D(Point2D((x - margin) / nb_tiles, (y - margin) / nb_tiles),
+                     Point2D((x + 1 + margin) / nb_tiles,
+                             (y + 1 + margin) / nb_tiles));
+    }
+
+    const WorldMultipolygon & geometry(
+        const TilePart<WorldMultipolygon> & part) const {
+        return part.clipped ? *part.clipped : all.areas[part.feature].geometry;
+    }
+
+    // the part of a feature inside the box, none if it avoids the box
+    template <typename Clipped, typename Geometry>
+    static std::optional<TilePart<Clipped>> clip(const TilePart<Clipped> & part,
+                                                 const Geometry & g,
+                                                 const Box2D & box) {
+        if(!boost::geometry::intersects(part.box, box)) return std::nullopt;
+        if(boost::geometry::covered_by(part.box, box)) return part;
+        auto clipped = std::make_shared<Clipped>();
+        try {
+            boost::geometry::intersection(g, box, *clipped);
+        } catch(const std::exception &) {
+            // invalid input of the overlay, not drawn
+            return std::nullopt;
+        }
+        if(clipped->empty()) return std::nullopt;
+        TilePart<Clipped> child{part.feature, nullptr, Box2D()};
+        boost::geometry::envelope(*clipped, child.box);
+        child.clipped = std::move(clipped);
+        return child;
+    }
+
+    // whether the clipped area is the whole box
+    static bool covers(const WorldMultipolygon & clipped, const Box2D & box) {
+        if(clipped.size() != 1 || !clipped.front().inners().empty())
+            return false;
+        return std::abs(boost::geometry::area(clipped)) >=
+               boost::geometry::area(box) * (1 - 1e-9);
+    }
+
+    TileParts clip(const TileParts & parts, const Box2D & box) const {
+        TileParts child;
+        for(const std::size_t i : parts.points)
+            if(boost::geometry::covered_by(all.points[i].geometry, box))
+                child.points.push_back(i);
+        for(const auto & part : parts.lines) {
+            std::optional<TilePart<MultiLinestring2D>> clipped =
+                part.clipped
+                    ? clip(part, *part.clipped, box)
+                    : clip(part, all.lines[part.feature].geometry, box);
+            if(clipped) child.lines.push_back(std::move(*clipped));
+        }
+        for(const auto & part : parts.areas) {
+            std::optional<TilePart<WorldMultipolygon>> clipped =
+                clip(part, geometry(part), box);
+            if(!clipped) continue;
+            if(clipped->clipped && covers(*clipped->clipped, box))
+                child.covering_areas.push_back(part.feature);
+            else
+                child.areas.push_back(std::move(*clipped));
+        }
+        // the areas covering a tile cover its children
+        child.covering_areas.insert(child.covering_areas.end(),
+                                    parts.covering_areas.begin(),
+                                    parts.covering_areas.end());
+        return child;
+    }
+
+    void writeTile(unsigned z, std::uint32_t x, std::uint32_t y,
+                   const TileParts & parts) const {
+        // one tile unit, the resolution of the zoom level, the features
+        // smaller than it vanish
+        const double tolerance =
+            std::ldexp(1.0 / MVTWriter::extent, -static_cast<int>(z));
+        auto collapses = [tolerance](const Box2D & box) {
+            return box.max_corner().x() - box.min_corner().x() < tolerance &&
+                   box.max_corner().y() - box.min_corner().y() < tolerance;
+        };
+
+        TileGeometryEncoder encoder(static_cast<int>(z), x, y);
+        TileBuilder builder;
+        for(const std::size_t i : parts.points) {
+            const auto & feature = all.points[i];
+            encoder.reset();
+            encoder.encode(builder.add(GeomType::point, feature.properties),
+                           feature.geometry);
+            builder.commit();
+        }
+        for(const auto & part : parts.lines) {
+            const auto & feature = all.lines[part.feature];
+            if(collapses(feature.box)) continue;
+            encoder.reset();
+            auto & geometry =
+                builder.add(GeomType::linestring, feature.properties);
+            Linestring2D simplified;
+            if(part.clipped) {
+                for(const Linestring2D & l : *part.clipped) {
+                    simplified.clear();
+                    boost::geometry::simplify(l, simplified, tolerance);
+                    encoder.encode(geometry, simplified);
+                }
+            } else {
+                boost::geometry::simplify(feature.geometry, simplified,
+                                          tolerance);
+                encoder.encode(geometry, simplified);
+            }
+            builder.commit();
+        }
+        // the areas whose simplification is invalid are kept as is
+        for(const auto & part : parts.areas) {
+            const auto & feature = all.areas[part.feature];
+            if(collapses(feature.box)) continue;
+            const WorldMultipolygon & mp = geometry(part);
+            WorldMultipolygon simplified;
+            boost::geometry::simplify(mp, simplified, tolerance);
+            encoder.reset();
+            encoder.encode(builder.add(GeomType::polygon, feature.properties),
+                           boost::geometry::num_points(simplified) <
+                                       boost::geometry::num_points(mp) &&
+                                   boost::geometry::is_valid(simplified)
+                               ? simplified
+                               : mp);
+            builder.commit();
+        }
+        if(!parts.covering_areas.empty()) {
+            WorldMultipolygon square;
+            boost::geometry::convert(clip_box(z, x, y),
+                                     square.emplace_back());
+            for(const std::size_t i : parts.covering_areas) {
+                encoder.reset();
+                encoder.encode(
+                    builder.add(GeomType::polygon, all.areas[i].properties),
+                    square);
+                builder.commit();
+            }
+        }
+
+        const std::string data = builder.build(layer_name);
+        if(data.empty()) return;
+        std::vector<char> compressed;
+        compress_block(options.compression, data, compressed);
+        const std::filesystem::path column_directory =
+            directory / std::to_string(z) / std::to_string(x);
+        // the columns are created concurrently by the tiles
+        std::error_code error;
+        std::filesystem::create_directories(column_directory, error);
+        std::ofstream pbf(column_directory / (std::to_string(y) + ".pbf"),
+                          std::ios::binary);
+        pbf.write(compressed.data(),
+                  static_cast<std::streamsize>(compressed.size()));
+        if(!pbf)
+            throw std::runtime_error("cannot write the tiles of " +
+                                     column_directory.string());
+    }
+
+    void write(unsigned z, std::uint32_t x, std::uint32_t y,
+               const TileParts & parts) const {
+        if(z >= options.min_zoom) writeTile(z, x, y, parts);
+        if(z == options.max_zoom) return;
+        tbb::parallel_for(0u, 4u, [&](unsigned child) {
+            const std::uint32_t child_x = 2 * x + (child & 1);
+            const std::uint32_t child_y = 2 * y + (child >> 1);
+            const TileParts child_parts =
+                clip(parts, clip_box(z + 1, child_x, child_y));
+            if(!child_parts.empty())
+                write(z + 1, child_x, child_y, child_parts);
+        });
+    }
+
+public:
+    TilePyramid(const MVTWriter::Features & p_all,
+                const std::filesystem::path & p_directory,
+                const std::string & p_layer_name, const MVTOptions & p_options)
+        : all(p_all)
+        , directory(p_directory)
+        , layer_name(p_layer_name)
+        , options(p_options) {}
+
+    void write() const {
+        TileParts root;
+        for(std::size_t i = 0; i < all.points.size(); ++i)
+            root.points.push_back(i);
+        for(std::size_t i = 0; i < all.lines.size(); ++i)
+            root.lines.push_back({i, nullptr, all.lines[i].box});
+        for(std::size_t i = 0; i < all.areas.size(); ++i)
+            root.areas.push_back({i, nullptr, all.areas[i].box});
+        write(0, 0, 0, root);
+    }
+};
+}  // namespace
+
+MVTWriter::MVTWriter(const std::filesystem::path & tiles_directory,
+                     MVTOptions p_options)
+    : directory(tiles_directory)
+    , layer_name(tiles_directory.filename().string())
+    , options(p_options)
+    , closed(false) {
+    if(options.min_zoom > options.max_zoom || options.max_zoom > 24)
+        throw std::invalid_argument(
+            "the zoom levels must satisfy min <= max <= 24");
+    std::filesystem::create_directories(directory);
+}
+
+MVTWriter::~MVTWriter() {
+    try {
+        close();
+    } catch(const std::exception & e) {
+        std::cerr << "Error: " << e.what() << "\n";
+    }
+}
+
+void MVTWriter::write(const Node & node) {
+    const Point2D p = to_world(node.point);
+    features.local().points.push_back({p, Box2D(p, p), node.properties});
+}
+
+void MVTWriter::write(const Way & way) {
+    Feature<Linestring2D> feature{{}, {}, way.properties};
+    for(const PointFixed & p : way.linestring)
+        feature.geometry.push_back(to_world(p));
+    boost::geometry::envelope(feature.geometry, feature.box);
+    features.local().lines.push_back(std::move(feature));
+}
+
+void MVTWriter::write(const Area & area) {
+    Feature<WorldMultipolygon> feature{{}, {}, area.properties};
+    for(const PolygonFixed & polygon : area.multipolygon) {
+        WorldPolygon & world_polygon = feature.geometry.emplace_back();
+        for(const PointFixed & p : polygon.outer())
+            world_polygon.outer().push_back(to_world(p));
+        for(const RingFixed & inner : polygon.inners()) {
+            auto & world_inner = world_polygon.inners().emplace_back();
+            for(const PointFixed & p : inner)
+                world_inner.push_back(to_world(p));
+        }
+    }
+    boost::geometry::envelope(feature.geometry, feature.box);
+    features.local().areas.push_back(std::move(feature));
+}
+
+void MVTWriter::writeMetadata(const Features & all) const {
+    Box2D box = boost::geometry::make_inverse<Box2D>();
+    std::set<std::string> fields;
+    auto add = [&box, &fields](const auto & kind_features) {
+        for(const auto & feature : kind_features) {
+            boost::geometry::expand(box, feature.box);
+            for(const auto & property : feature.properties)
+                fields.emplace(property.first);
+        }
+    };
+    add(all.points);
+    add(all.lines);
+    add(all.areas);
+
+    nlohmann::json layer = {{"id", layer_name},
+                            {"minzoom", options.min_zoom},
+                            {"maxzoom", options.max_zoom},
+                            {"fields", nlohmann::json::object()}};
+    for(const std::string & field : fields) layer["fields"][field] = "String";
+    nlohmann::json metadata = {{"tilejson", "3.0.0"},
+                               {"name", layer_name},
+                               {"format", "pbf"},
+                               {"compression",
+                                compression_name(options.compression)},
+                               {"tiles", {"{z}/{x}/{y}.pbf"}},
+                               {"minzoom", options.min_zoom},
+                               {"maxzoom", options.max_zoom},
+                               {"vector_layers", {layer}}};
+    if(box.min_corner().x() <= box.max_corner().x()) {
+        // the world y axis points south
+        const PointGeo south_west =
+            to_geo(Point2D(box.min_corner().x(), box.max_corner().y()));
+        const PointGeo north_east =
+            to_geo(Point2D(box.max_corner().x(), box.min_corner().y()));
+        metadata["bounds"] = {south_west.x(), south_west.y(),
+                              north_east.x(), north_east.y()};
+    }
+    std::ofstream json(directory / "metadata.json");
+    json << metadata.dump(2) << std::endl;
+}
+
+void MVTWriter::close() {
+    if(closed) return;
+    closed = true;
+    Features all;
+    features.combine_each([&all](Features & local) {
+        std::move(local.points.begin(), local.points.end(),
+                  std::back_inserter(all.points));
+        std::move(local.lines.begin(), local.lines.end(),
+                  std::back_inserter(all.lines));
+        std::move(local.areas.begin(), local.areas.end(),
+                  std::back_inserter(all.areas));
+        local = Features{};
+    });
+    tbb::task_arena arena(static_cast<int>(options.nb_threads));
+    arena.execute(
+        [&] { TilePyramid(all, directory, layer_name, options).write(); });
+    writeMetadata(all);
+}
+}  // namespace IO
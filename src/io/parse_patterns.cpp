@@ -23,7 +23,9 @@ parse_node_pattern(const nlohmann::json & pattern) {
     std::vector<std::pair<std::string, std::string>> exported_properties;
     if(pattern.contains("exportProperties"))
         for(auto & [tag, value] : pattern.at("exportProperties").items())
-            exported_properties.emplace_back(tag, value.dump());
+            exported_properties.emplace_back(
+                tag, value.is_string() ? value.get<std::string>()
+                                       : value.dump());
 
     std::vector<std::string> forwarded_properties;
     if(pattern.contains("forwardProperties"))
@@ -33,7 +35,8 @@ parse_node_pattern(const nlohmann::json & pattern) {
     return std::make_pair(
         parse_tags_rule(pattern),
         NodeBuilder(std::move(exported_properties),
-                    std::move(forwarded_properties)));
+                    std::move(forwarded_properties),
+                    pattern.value("inflatedWidth", 0.0f)));
 }
 std::vector<std::pair<
     std::vector<std::pair<std::string, osmium::StringMatcher>>, NodeBuilder>>
@@ -53,7 +56,9 @@ parse_way_pattern(const nlohmann::json & pattern) {
     std::vector<std::pair<std::string, std::string>> exported_properties;
     if(pattern.contains("exportProperties"))
         for(auto & [tag, value] : pattern.at("exportProperties").items())
-            exported_properties.emplace_back(tag, value.dump());
+            exported_properties.emplace_back(
+                tag, value.is_string() ? value.get<std::string>()
+                                       : value.dump());
 
     std::vector<std::string> forwarded_properties;
     if(pattern.contains("forwardProperties"))
@@ -63,7 +68,9 @@ parse_way_pattern(const nlohmann::json & pattern) {
     return std::make_pair(
         parse_tags_rule(pattern),
         WayBuilder(std::move(exported_properties),
-                   std::move(forwarded_properties)));
+                   std::move(forwarded_properties),
+                   pattern.value("inflatedWidth", 0.0f),
+                   pattern.value("simplifyTolerance", -1.0f)));
 }
 std::vector<std::pair<
     std::vector<std::pair<std::string, osmium::StringMatcher>>, WayBuilder>>
@@ -82,16 +89,20 @@ parse_area_pattern(const nlohmann::json & pattern) {
     std::vector<std::pair<std::string, std::string>> exported_properties;
     if(pattern.contains("exportProperties"))
         for(auto & [tag, value] : pattern.at("exportProperties").items())
-            exported_properties.emplace_back(tag, value.dump());
+            exported_properties.emplace_back(
+                tag, value.is_string() ? value.get<std::string>()
+                                       : value.dump());
 
     std::vector<std::string> forwarded_properties;
     if(pattern.contains("forwardProperties"))
         for(auto & tag : pattern.at("forwardProperties"))
             forwarded_properties.emplace_back(tag.get<const std::string>());
 
-    return std::make_pair(parse_tags_rule(pattern),
-                          AreaBuilder(std::move(exported_properties),
-                                      std::move(forwarded_properties)));
+    return std::make_pair(
+        parse_tags_rule(pattern),
+        AreaBuilder(std::move(exported_properties),
+                    std::move(forwarded_properties),
+                    pattern.value("simplifyTolerance", -1.0f)));
 }
 std::vector<std::pair<
     std::vector<std::pair<std::string, osmium::StringMatcher>>, AreaBuilder>>
@@ -28,11 +28,13 @@ void print_svg_result(const std::vector<Node> & nodes,
             areas.cbegin(), areas.cend(), regions.begin(),
             [](const Area & r) {
                 return std::make_pair(
-                    r.multipolygon,
+                    convert_geometry<MultipolygonGeo>(r.multipolygon),
                     std::make_pair(
-                        std::atof(r.getProperty("qualityCoef").c_str()),
                         std::atof(
-                            r.getProperty("probConnectionPerMeter").c_str())));
+                            std::string(r.getProperty("qualityCoef")).c_str()),
+                        std::atof(std::string(r.getProperty(
+                                                  "probConnectionPerMeter"))
+                                      .c_str())));
             });
     } catch(std::invalid_argument & e) {
         throw std::runtime_error(
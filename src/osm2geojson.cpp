@@ -1,13 +1,20 @@
 #include <filesystem>  // filesystem::path
 #include <fstream>     // ofstream
 #include <iostream>    // std::cout, std::cerr
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "bg_types.hpp"
 #include "io/geojson_parser.hpp"
+#include "io/geojson_writer.hpp"
+#include "io/output_format.hpp"
 #include "io/print_geojson.hpp"
 #include "io/print_svg_result.hpp"
 #include "query_osm_file.hpp"
 
+#include <boost/algorithm/string/trim.hpp>
 #include <boost/program_options.hpp>
 namespace bpo = boost::program_options;
 
@@ -23,28 +30,140 @@ void init_logging(bool no_warnings) {
             : (logging::trivial::severity >= logging::trivial::warning));
 }
 
+// prints the counters of a query, and the summary of its geometry errors as
+// a single warning
+void print_stats(const BGDumpStats & stats) {
+    std::cout << stats << std::endl;
+    if(!stats.errors.empty())
+        BOOST_LOG_TRIVIAL(warning)
+            << "Geometry errors (count and sample ids):" << stats.errors;
+}
+
+// patterns file and output file of a batched query
+struct BatchQuery {
+    std::filesystem::path patterns_file;
+    std::filesystem::path output_file;
+};
+
 static bool process_command_line(int argc, char * argv[],
                                  std::filesystem::path & input_file,
                                  std::filesystem::path & patterns_file,
                                  std::filesystem::path & output_file,
                                  std::filesystem::path & area_file,
+                                 std::filesystem::path & area_pattern_file,
                                  bool & provided_area_file, bool & generate_svg,
-                                 bool & no_warnings) {
+                                 bool & no_warnings, int & precision,
+                                 std::string & regions_property,
+                                 IO::OutputOptions & output,
+                                 std::vector<BatchQuery> & batch,
+                                 QueryOptions & options) {
     try {
+        std::size_t memory_budget_mib;
+        std::string validation;
+        std::string predicate_cs;
+        std::string simplify_method;
+        std::string output_format;
+        std::string compression;
+        std::vector<std::string> batch_queries;
+        std::filesystem::path batch_manifest;
         bpo::options_description desc("Allowed options");
         desc.add_options()("help,h", "produce help message")(
             "input,i",
             bpo::value<std::filesystem::path>(&input_file)->required(),
             "set input PBF file")(
             "patterns,p",
-            bpo::value<std::filesystem::path>(&patterns_file)->required(),
+            bpo::value<std::filesystem::path>(&patterns_file),
             "set regions patterns description json file")(
             "output,o",
-            bpo::value<std::filesystem::path>(&output_file)->required(),
-            "set output geojson file")(
+            bpo::value<std::filesystem::path>(&output_file),
+            "set output geojson or flatgeobuf file, or mvt tiles directory")(
+            "format",
+            bpo::value<std::string>(&output_format)->default_value("auto"),
+            "set the output format: 'geojson', 'flatgeobuf' (with a packed "
+            "Hilbert R-tree index for bounding box reads), 'mvt' (a "
+            "<z>/<x>/<y>.pbf vector tiles pyramid) or 'auto' from the "
+            "output extension, '.fgb' for flatgeobuf")(
+            "min-zoom",
+            bpo::value<unsigned>(&output.mvt.min_zoom)->default_value(0),
+            "set the lowest zoom level of the mvt tiles")(
+            "max-zoom",
+            bpo::value<unsigned>(&output.mvt.max_zoom)->default_value(14),
+            "set the highest zoom level of the mvt tiles")(
+            "compress",
+            bpo::value<std::string>(&compression)->default_value("none"),
+            "compress the geojson outputs, adding the '.gz' or '.zst' "
+            "extension, or the mvt tiles: 'none', 'gzip' or 'zstd', the "
+            "blocks of each thread are compressed in parallel")(
+            "batch", bpo::value<std::vector<std::string>>(&batch_queries)
+                         ->multitoken(),
+            "instead of patterns and output, set several "
+            "'<patterns>,<output>' pairs queried in a single pass")(
+            "batch-manifest",
+            bpo::value<std::filesystem::path>(&batch_manifest),
+            "set a file of '<patterns> <output>' lines queried in a single "
+            "pass, relative to the manifest directory")(
             "search-area,a", bpo::value<std::filesystem::path>(&area_file),
             "set search area geojson file")(
+            "search-area-pattern",
+            bpo::value<std::filesystem::path>(&area_pattern_file),
+            "set a patterns json file whose area patterns select the "
+            "multipolygon relations of the input file making the search area")(
+            "regions-property",
+            bpo::value<std::string>(&regions_property),
+            "make every feature of the search area file a region written to "
+            "<output>/<value of this property>.geojson (.fgb, or a tiles "
+            "directory), in a single pass")(
             "svg", "generate the svg file of the result regions")(
+            "precision", bpo::value<int>(&precision)->default_value(-1),
+            "set the number of decimals, up to 17, of the output coordinates, "
+            "-1 for the shortest exact representation (7 decimals is about "
+            "1 cm), the consecutive points rounded to the same one are merged")(
+            "threads,t",
+            bpo::value<unsigned>(&options.nb_threads)->default_value(1),
+            "set the number of threads matching and building geometries")(
+            "location-index",
+            bpo::value<std::string>(&options.location_index)
+                ->default_value(options.location_index),
+            "set the node locations index: a libosmium map type (flex_mem, "
+            "sparse_mem_array, dense_mmap_array, sparse_file_array, "
+            "dense_file_array, ...) followed by ',<file>' for the file based "
+            "ones, overwriting the file, or 'auto[,<file>]' to choose it from "
+            "the input size and the memory budget")(
+            "memory-budget",
+            bpo::value<std::size_t>(&memory_budget_mib)->default_value(8192),
+            "set the memory, in MiB, that the 'auto' location index may use")(
+            "cache-dir", bpo::value<std::filesystem::path>(&options.cache_dir),
+            "set a directory caching the node locations and multipolygon "
+            "relations of the input file, the next queries on the same file "
+            "skip storing node locations (overrides --location-index and "
+            "--needed-nodes-only)")(
+            "validation",
+            bpo::value<std::string>(&validation)->default_value("full"),
+            "set the validation of the geometries: 'none', 'fast' for linear "
+            "time checks of the rings, 'full' to discard the invalid ones or "
+            "'repair' to repair them")(
+            "predicate-cs",
+            bpo::value<std::string>(&predicate_cs)
+                ->default_value("geographic"),
+            "set the coordinate system of the tests against the search area: "
+            "'cartesian' (planar longitudes and latitudes, fastest), "
+            "'spherical' or 'geographic' (WGS84 ellipsoid)")(
+            "simplify",
+            bpo::value<double>(&options.simplify.tolerance)->default_value(0),
+            "set the tolerance, in meters, of the simplification of the ways "
+            "and areas whose pattern has no 'simplifyTolerance', 0 for none")(
+            "simplify-method",
+            bpo::value<std::string>(&simplify_method)
+                ->default_value("douglas-peucker"),
+            "set the simplification algorithm: 'douglas-peucker' or "
+            "'visvalingam'")(
+            "clip",
+            "output the parts of the ways and areas inside the search area, "
+            "or inside each region, instead of the ways inside it and the "
+            "whole areas intersecting it")(
+            "needed-nodes-only",
+            "index only the locations of the nodes of the ways that may "
+            "match a rule, found by an additional pass over the ways")(
             "no-warnings", "silence warning prints");
         bpo::positional_options_description p;
         p.add("input", 1).add("patterns", 1).add("output", 1);
@@ -62,6 +181,76 @@ static bool process_command_line(int argc, char * argv[],
         provided_area_file = (vm.count("search-area") > 0);
         generate_svg = (vm.count("svg") > 0);
         no_warnings = (vm.count("no-warnings") > 0);
+        options.needed_nodes_only = (vm.count("needed-nodes-only") > 0);
+        options.clip = (vm.count("clip") > 0);
+        for(const std::string & query : batch_queries) {
+            const std::size_t comma = query.find(',');
+            if(comma == std::string::npos)
+                throw std::invalid_argument("batch query '" + query +
+                                            "' is not '<patterns>,<output>'");
+            batch.push_back(
+                {query.substr(0, comma), query.substr(comma + 1)});
+        }
+        if(!batch_manifest.empty()) {
+            std::ifstream manifest(batch_manifest);
+            if(!manifest)
+                throw std::invalid_argument("cannot open " +
+                                            batch_manifest.string());
+            const std::filesystem::path dir = batch_manifest.parent_path();
+            std::string line;
+            while(std::getline(manifest, line)) {
+                std::istringstream fields(line);
+                std::string patterns, output;
+                if(!(fields >> patterns) || patterns.front() == '#') continue;
+                if(!(fields >> output))
+                    throw std::invalid_argument("manifest line '" + line +
+                                                "' has no output");
+                batch.push_back({dir / patterns, dir / output});
+            }
+        }
+        if(batch.empty() && (patterns_file.empty() || output_file.empty()))
+            throw std::invalid_argument(
+                "patterns and output are required without batch");
+        if(!batch.empty() && (!patterns_file.empty() ||
+                              !regions_property.empty() || generate_svg))
+            throw std::invalid_argument(
+                "batch cannot be used with patterns, regions-property or svg");
+        if(provided_area_file && !area_pattern_file.empty())
+            throw std::invalid_argument(
+                "search-area and search-area-pattern are exclusive");
+        if(!regions_property.empty() && !provided_area_file)
+            throw std::invalid_argument(
+                "regions-property requires a search area file");
+        if(!regions_property.empty() && generate_svg)
+            throw std::invalid_argument(
+                "regions-property cannot be used with svg");
+        if(options.nb_threads == 0)
+            throw std::invalid_argument("threads must be at least 1");
+        if(!is_location_index_type(options.location_index))
+            throw std::invalid_argument("unknown location index type in " +
+                                        options.location_index);
+        if(precision < -1 || precision > 17)
+            throw std::invalid_argument("precision must be in [-1, 17]");
+        output.format = IO::output_format_from_string(output_format);
+        output.precision = precision;
+        output.compression = IO::compression_from_string(compression);
+        output.mvt.nb_threads = options.nb_threads;
+        if(generate_svg &&
+           IO::resolve_output_format(output.format, output_file) !=
+               IO::OutputFormat::geojson)
+            throw std::invalid_argument("svg requires the geojson format");
+        if(generate_svg && output.compression != IO::Compression::none)
+            throw std::invalid_argument("svg cannot be used with compress");
+        if(output.mvt.min_zoom > output.mvt.max_zoom ||
+           output.mvt.max_zoom > 24)
+            throw std::invalid_argument(
+                "zoom levels must satisfy min-zoom <= max-zoom <= 24");
+        options.memory_budget = memory_budget_mib << 20;
+        options.validation = validation_mode_from_string(validation);
+        options.predicate_cs = predicate_cs_from_string(predicate_cs);
+        options.simplify.method = simplify_method_from_string(simplify_method);
+        // the rounded coordinates are deduplicated before the output
+        options.simplify.precision = precision;
     } catch(std::exception & e) {
         std::cerr << "Error: " << e.what() << "\n";
         return false;
@@ -71,21 +260,96 @@ static bool process_command_line(int argc, char * argv[],
 
 #include "chrono.hpp"
 
+// Loads every feature of the area file as a region whose output file is
+// named after the given property, in the output directory.
+std::vector<IO::RegionsRouter::Region> load_regions(
+    const std::filesystem::path & area_file, const std::string & property,
+    const std::filesystem::path & output_dir, const IO::OutputOptions & output,
+    PredicateCS predicate_cs) {
+    // small buffers since there may be thousands of regions
+    constexpr std::size_t region_buffer_size = 1 << 16;
+
+    simdjson::ondemand::parser parser;
+    auto json = simdjson::padded_string::load(area_file.string());
+    auto doc = parser.iterate(json);
+
+    if(doc.find_field("type") != "FeatureCollection")
+        throw std::runtime_error(area_file.filename().string() +
+                                 " is not of type FeatureCollection");
+
+    std::vector<IO::RegionsRouter::Region> regions;
+    std::set<std::string> names;
+    for(auto region : doc.find_field("features").get_array()) {
+        auto value = region.find_field_unordered("properties")
+                         .find_field_unordered(property);
+        std::string name;
+        if(value.type() == simdjson::ondemand::json_type::string)
+            name = std::string(std::string_view(value.get_string()));
+        else
+            name = std::string(std::string_view(value.raw_json_token()));
+        boost::algorithm::trim(name);
+        std::replace(name.begin(), name.end(), '/', '_');
+        if(name.empty() || !names.insert(name).second)
+            throw std::runtime_error("empty or duplicate region name '" +
+                                     name + "'");
+
+        auto geometry = region.find_field_unordered("geometry");
+        if(geometry.find_field("type") != "MultiPolygon")
+            throw std::runtime_error(
+                "region geometry with type != MultiPolygon");
+        auto area = std::make_shared<const PreparedSearchArea>(
+            IO::detail::parse_geojson_multipolygon<MultipolygonGeo>(
+                geometry.find_field("coordinates").get_array()),
+            predicate_cs);
+        // the output directory has no extension, auto is geojson
+        auto sink = IO::make_feature_sink(
+            output_dir / (name + IO::output_format_extension(output.format)),
+            output, region_buffer_size);
+        regions.push_back({std::move(name), std::move(area), std::move(sink)});
+    }
+    return regions;
+}
+
 int main(int argc, char * argv[]) {
     std::filesystem::path input_file;
     std::filesystem::path patterns_file;
     std::filesystem::path output_file;
     std::filesystem::path area_file;
+    std::filesystem::path area_pattern_file;
     bool provided_area_file;
     bool generate_svg;
     bool no_warnings;
+    int precision;
+    std::string regions_property;
+    IO::OutputOptions output;
+    std::vector<BatchQuery> batch;
+    QueryOptions options;
 
     bool valid_command = process_command_line(
         argc, argv, input_file, patterns_file, output_file, area_file,
-        provided_area_file, generate_svg, no_warnings);
+        area_pattern_file, provided_area_file, generate_svg, no_warnings,
+        precision, regions_property, output, batch, options);
     if(!valid_command) return EXIT_FAILURE;
     init_logging(no_warnings);
 
+    if(!regions_property.empty()) {
+        Chrono chrono;
+        std::filesystem::create_directories(output_file);
+        auto router = std::make_shared<IO::RegionsRouter>(
+            load_regions(area_file, regions_property, output_file, output,
+                         options.predicate_cs),
+            options.clip);
+        std::cout << "Loaded " << router->getRegions().size() << " regions in "
+                  << chrono.lapTimeMs() << " ms" << std::endl;
+        BGDumpHandler bg_handler =
+            query_osm_regions(input_file, patterns_file, router, options);
+        router->close();
+        std::cout << "Query and printed geojson in " << chrono.lapTimeMs()
+                  << " ms" << std::endl;
+        print_stats(bg_handler.getStats());
+        return EXIT_SUCCESS;
+    }
+
     MultipolygonGeo search_area;
     if(provided_area_file) {
         simdjson::ondemand::parser parser;
@@ -110,20 +374,57 @@ int main(int argc, char * argv[]) {
 
     Chrono chrono;
 
+    if(!area_pattern_file.empty()) {
+        search_area =
+            query_osm_search_area(input_file, area_pattern_file, options);
+        std::cout << "Built search area in " << chrono.lapTimeMs() << " ms"
+                  << std::endl;
+    }
+
+    if(!batch.empty()) {
+        std::vector<std::filesystem::path> patterns_files;
+        std::vector<std::shared_ptr<IO::FeatureSink>> writers;
+        for(const BatchQuery & query : batch) {
+            patterns_files.push_back(query.patterns_file);
+            writers.push_back(
+                IO::make_feature_sink(query.output_file, output));
+        }
+        std::vector<BGDumpHandler> handlers = query_osm_batch(
+            input_file, patterns_files, search_area, options, writers);
+        for(auto & writer : writers) writer->close();
+        std::cout << "Query and printed " << batch.size() << " geojson in "
+                  << chrono.lapTimeMs() << " ms" << std::endl;
+        for(std::size_t i = 0; i < batch.size(); ++i) {
+            std::cout << batch[i].patterns_file.filename().string() << ": ";
+            print_stats(handlers[i].getStats());
+        }
+        return EXIT_SUCCESS;
+    }
+
+    if(!generate_svg) {
+        // features are written while the input file is read
+        auto writer = IO::make_feature_sink(output_file, output);
+        BGDumpHandler bg_handler =
+            query_osm(input_file, patterns_file, search_area, options, writer);
+        writer->close();
+        std::cout << "Query and printed geojson in " << chrono.lapTimeMs()
+                  << " ms" << std::endl;
+        print_stats(bg_handler.getStats());
+        return EXIT_SUCCESS;
+    }
+
     BGDumpHandler bg_handler =
-        query_osm(input_file, patterns_file, search_area);
+        query_osm(input_file, patterns_file, search_area, options);
     std::cout << "Query result in " << chrono.lapTimeMs() << " ms" << std::endl;
+    print_stats(bg_handler.getStats());
 
     IO::print_geojson(bg_handler.getNodes(), bg_handler.getWays(),
-                      bg_handler.getAreas(), output_file);
+                      bg_handler.getAreas(), output_file, precision);
     std::cout << "Printed geojson in " << chrono.lapTimeMs() << " ms"
               << std::endl;
 
-    if(generate_svg) {
-        IO::print_svg_result(bg_handler.getNodes(), bg_handler.getWays(),
-                             bg_handler.getAreas(),
-                             output_file.replace_extension(".svg"));
-        std::cout << "Printed svg in " << chrono.lapTimeMs() << " ms"
-                  << std::endl;
-    }
+    IO::print_svg_result(bg_handler.getNodes(), bg_handler.getWays(),
+                         bg_handler.getAreas(),
+                         output_file.replace_extension(".svg"));
+    std::cout << "Printed svg in " << chrono.lapTimeMs() << " ms" << std::endl;
 }
\ No newline at end of file
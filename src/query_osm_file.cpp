@@ -1,56 +1,603 @@
 #include "query_osm_file.hpp"
 #include <osmium/util/progress_bar.hpp>
 
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include <osmium/index/map/all.hpp>
+#include <osmium/io/any_output.hpp>
+
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_pipeline.h>
+#include <tbb/task_arena.h>
+
+#include "chrono.hpp"
+#include "osmium_utils/bg_dump_handler_batch.hpp"
 #include "osmium_utils/filteringMultipolygonManager.hpp"
+#include "osmium_utils/needed_nodes.hpp"
 
-using index_type = osmium::index::map::FlexMem<osmium::unsigned_object_id_type,
-                                               osmium::Location>;
+using index_type =
+    osmium::index::map::Map<osmium::unsigned_object_id_type, osmium::Location>;
+using index_factory_type =
+    osmium::index::MapFactory<osmium::unsigned_object_id_type,
+                              osmium::Location>;
 using location_handler_type = osmium::handler::NodeLocationsForWays<index_type>;
 
 namespace bg = boost::geometry;
 namespace ba = boost::adaptors;
 
-void do_query(const osmium::io::File & osm_file, BGDumpHandler & bg_handler) {
+// approximative size of a node in a PBF file and number of node ids allocated
+// by OpenStreetMap, used to estimate the size of the location indexes
+constexpr std::size_t pbf_bytes_per_node = 8;
+constexpr std::size_t osm_max_node_id = 13'000'000'000;
+
+// splits a location index specification "type[,file]"
+std::pair<std::string, std::string> split_location_index(
+    const std::string & location_index) {
+    const std::size_t comma = location_index.find(',');
+    if(comma == std::string::npos) return {location_index, ""};
+    return {location_index.substr(0, comma), location_index.substr(comma + 1)};
+}
+
+bool is_location_index_type(const std::string & location_index) {
+    const std::string type = split_location_index(location_index).first;
+    return type == "auto" ||
+           index_factory_type::instance().has_map_type(type);
+}
+
+// Sparse indexes store 16 bytes per node and dense ones 8 bytes per node id.
+// The in memory indexes are preferred if they fit in the memory budget, then
+// the smallest file index.
+std::string auto_location_index(const std::filesystem::path & input_file,
+                                const std::string & index_file,
+                                std::size_t memory_budget) {
+    const std::size_t nb_nodes =
+        std::filesystem::file_size(input_file) / pbf_bytes_per_node;
+    const std::size_t sparse_size = 16 * nb_nodes;
+    const std::size_t dense_size = 8 * osm_max_node_id;
+    if(sparse_size <= memory_budget) return "sparse_mem_array";
+    if(dense_size <= memory_budget) return "dense_mmap_array";
+    const std::string type =
+        sparse_size < dense_size ? "sparse_file_array" : "dense_file_array";
+    return index_file.empty() ? type : type + ',' + index_file;
+}
+
+std::unique_ptr<index_type> create_location_index(
+    const std::string & location_index, bool reuse_file = false) {
+    const auto & [type, file] = split_location_index(location_index);
+    if(!index_factory_type::instance().has_map_type(type))
+        throw std::invalid_argument("unknown location index type " + type);
+    // the file indexes would append to the content of an existing file
+    if(!file.empty() && !reuse_file) std::filesystem::remove(file);
+    return index_factory_type::instance().create_map(location_index);
+}
+
+// 64 bits FNV-1a hash, stable across runs and standard libraries
+std::uint64_t fnv1a(std::string_view s) {
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for(const char c : s) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// Node locations and multipolygon relations of an input file, stored in a
+// subdirectory of the cache directory named after the file name, size and
+// modification time. The cache is complete once the marker file exists.
+struct InputCache {
+    std::filesystem::path directory;
+
+    static std::string input_key(const std::filesystem::path & input_file) {
+        return input_file.filename().string() + '-' +
+               std::to_string(std::filesystem::file_size(input_file)) + '-' +
+               std::to_string(std::filesystem::last_write_time(input_file)
+                                  .time_since_epoch()
+                                  .count());
+    }
+
+    InputCache(const std::filesystem::path & cache_dir,
+               const std::filesystem::path & input_file)
+        : directory(cache_dir / input_key(input_file)) {}
+
+    std::string location_index() const {
+        return "dense_file_array," + (directory / "locations.dat").string();
+    }
+    std::filesystem::path relations_file() const {
+        return directory / "relations.osm.pbf";
+    }
+    std::filesystem::path complete_marker() const {
+        return directory / "complete";
+    }
+
+    bool complete() const {
+        return std::filesystem::exists(complete_marker());
+    }
+    void create() const {
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+    }
+    void mark_complete() const { std::ofstream{complete_marker()}; }
+};
+
+// copies the relations that may be multipolygons into the cache
+void write_cache_relations(const osmium::io::File & osm_file,
+                           const InputCache & cache) {
+    osmium::io::Reader reader{osm_file, osmium::osm_entity_bits::relation,
+                              osmium::io::read_meta::no};
+    osmium::io::Writer writer{cache.relations_file().string(),
+                              osmium::io::overwrite::allow};
+    while(osmium::memory::Buffer buffer = reader.read()) {
+        for(const auto & relation : buffer.select<osmium::Relation>()) {
+            const char * type = relation.tags().get_value_by_key("type");
+            if(type != nullptr && (!std::strcmp(type, "multipolygon") ||
+                                   !std::strcmp(type, "boundary")))
+                writer(relation);
+        }
+    }
+    writer.close();
+    reader.close();
+}
+
+void print_location_index_footprint(const std::string & location_index,
+                                    const index_type & index) {
+    const auto & [type, file] = split_location_index(location_index);
+    const bool file_based = type.find("_file_") != std::string::npos;
+    const std::size_t memory = file_based ? 0 : index.used_memory();
+    const std::size_t disk =
+        file_based ? (file.empty() ? index.used_memory()
+                                   : std::filesystem::file_size(file))
+                   : 0;
+    std::cout << "Location index " << type << ": " << (memory >> 20)
+              << " MiB in memory, " << (disk >> 20) << " MiB on disk"
+              << std::endl;
+}
+
+// osmium::relations::read_relations without reading the metadata
+template <typename... Managers>
+void read_relations_without_meta(const osmium::io::File & osm_file,
+                                 Managers &&... managers) {
+    osmium::io::Reader reader{osm_file, osmium::osm_entity_bits::relation,
+                              osmium::io::read_meta::no};
+    osmium::apply(reader, managers...);
+    reader.close();
+    (managers.prepare_for_lookup(), ...);
+}
+
+// entities and fields of the input file read by the passes of a query
+struct ReadPlan {
+    bool relations_pass;
+    osmium::osm_entity_bits::type main_entities;
+    // if false, the main pass does not store any node location
+    bool store_locations;
+
+    /**
+     * @param cached_locations If the node locations are read from a
+     * complete cache.
+     * @param filling_cache If the node locations are written to a cache,
+     * which then needs every node location whatever the rules.
+     */
+    template <typename DumpHandler>
+    ReadPlan(const DumpHandler & bg_handler, bool cached_locations,
+             bool filling_cache) {
+        // the areas of the relations are assembled from their member ways,
+        // so the relations are only needed by the relations pass
+        const bool ways = bg_handler.hasWayRules() || bg_handler.hasAreaRules();
+        const bool nodes = bg_handler.hasNodeRules() || filling_cache ||
+                           (ways && !cached_locations);
+        relations_pass = bg_handler.hasAreaRules();
+        main_entities =
+            (nodes ? osmium::osm_entity_bits::node
+                   : osmium::osm_entity_bits::nothing) |
+            (ways ? osmium::osm_entity_bits::way
+                  : osmium::osm_entity_bits::nothing);
+        store_locations = filling_cache || (ways && !cached_locations);
+    }
+};
+
+std::ostream & operator<<(std::ostream & os,
+                          osmium::osm_entity_bits::type entities) {
+    const char * separator = "";
+    for(const auto & [bit, name] :
+        {std::make_pair(osmium::osm_entity_bits::node, "nodes"),
+         std::make_pair(osmium::osm_entity_bits::way, "ways"),
+         std::make_pair(osmium::osm_entity_bits::relation, "relations")}) {
+        if((entities & bit) == osmium::osm_entity_bits::nothing) continue;
+        os << separator << name;
+        separator = ", ";
+    }
+    return os;
+}
+
+// a buffer of located OSM objects and the areas to assemble from the
+// relations completed and the closed ways read with it
+struct HandlerChunk {
+    osmium::memory::Buffer buffer;
+    osmium::memory::Buffer assembly_jobs;
+};
+
+// The input stage reads the buffers, stores the node locations and collects
+// the relation members in file order, queuing the assembly of the areas
+// instead of running it. The parallel stage gives the entities of a chunk to
+// a per-thread handler and assembles its areas into a per-thread buffer, so
+// that big relations do not stall the reading.
+template <typename LocationHandler, typename MPManager, typename DumpHandler>
+void parallel_apply(osmium::io::Reader & reader,
+                    LocationHandler & location_handler, MPManager & mp_manager,
+                    DumpHandler & bg_handler, osmium::ProgressBar & progress,
+                    unsigned nb_threads) {
+    tbb::enumerable_thread_specific<DumpHandler> thread_handlers(bg_handler);
+    tbb::enumerable_thread_specific<osmium::memory::Buffer> area_buffers([] {
+        return osmium::memory::Buffer{1024 * 1024,
+                                      osmium::memory::Buffer::auto_grow::yes};
+    });
+    mp_manager.defer_assembly();
+    auto & mp_handler = mp_manager.handler();
+    bool input_done = false;
+
+    tbb::task_arena arena(static_cast<int>(nb_threads));
+    arena.execute([&] {
+        tbb::parallel_pipeline(
+            4 * nb_threads,
+            tbb::make_filter<void, std::shared_ptr<HandlerChunk>>(
+                tbb::filter_mode::serial_in_order,
+                [&](tbb::flow_control & fc) -> std::shared_ptr<HandlerChunk> {
+                    if(input_done) {
+                        fc.stop();
+                        return nullptr;
+                    }
+                    auto chunk = std::make_shared<HandlerChunk>();
+                    chunk->buffer = reader.read();
+                    if(chunk->buffer) {
+                        // node locations and relation members must be
+                        // handled in file order
+                        osmium::apply(chunk->buffer, location_handler,
+                                      mp_handler);
+                        progress.update(reader.offset());
+                    } else {
+                        mp_handler.flush();
+                        input_done = true;
+                    }
+                    chunk->assembly_jobs = mp_manager.release_jobs();
+                    return chunk;
+                }) &
+                tbb::make_filter<std::shared_ptr<HandlerChunk>, void>(
+                    tbb::filter_mode::parallel,
+                    [&](std::shared_ptr<HandlerChunk> chunk) {
+                        DumpHandler & handler = thread_handlers.local();
+                        if(chunk->buffer) osmium::apply(chunk->buffer, handler);
+                        if(!chunk->assembly_jobs) return;
+                        osmium::memory::Buffer & areas = area_buffers.local();
+                        mp_manager.assemble(chunk->assembly_jobs, areas);
+                        osmium::apply(areas, handler);
+                        areas.clear();
+                    }));
+    });
+
+    thread_handlers.combine_each(
+        [&bg_handler](DumpHandler & h) { bg_handler.merge(std::move(h)); });
+}
+
+template <typename DumpHandler>
+void do_query(const std::filesystem::path & input_file,
+              DumpHandler & bg_handler, const QueryOptions & options) {
+    osmium::io::File osm_file(input_file);
+
     osmium::area::Assembler::config_type assembler_config;
     osmium::area::FilteringMultipolygonManager<osmium::area::Assembler>
         mp_manager{assembler_config, bg_handler.getAreaEnglobingFilter(),
                    bg_handler.getSearchBox()};
-    osmium::relations::read_relations(osm_file, mp_manager);
+    std::optional<InputCache> cache;
+    bool cached_locations = false;
+    if(!options.cache_dir.empty()) {
+        cache.emplace(options.cache_dir, input_file);
+        cached_locations = cache->complete();
+        if(!cached_locations) {
+            cache->create();
+            write_cache_relations(osm_file, *cache);
+        }
+    }
+    const ReadPlan plan(bg_handler, cached_locations,
+                        cache.has_value() && !cached_locations);
+    // the cache holds every node location whatever the rules
+    const bool needed_nodes_only =
+        options.needed_nodes_only && !cache && plan.store_locations;
+
+    Chrono chrono;
+    NeededNodesCollector needed_nodes_collector{bg_handler, mp_manager};
+    if(plan.relations_pass) {
+        if(cache)
+            read_relations_without_meta(
+                osmium::io::File{cache->relations_file().string()},
+                mp_manager);
+        else if(needed_nodes_only)
+            read_relations_without_meta(osm_file, mp_manager,
+                                        needed_nodes_collector);
+        else
+            read_relations_without_meta(osm_file, mp_manager);
+        std::cout << "Relations pass in " << chrono.lapTimeMs() << " ms"
+                  << std::endl;
+    }
+    if(needed_nodes_only) {
+        osmium::io::Reader ways_reader{osm_file, osmium::osm_entity_bits::way,
+                                       osmium::io::read_meta::no};
+        osmium::apply(ways_reader, needed_nodes_collector);
+        ways_reader.close();
+        const node_id_set_type & needed_nodes =
+            needed_nodes_collector.getNeededNodes();
+        std::cout << "Ways pre-pass in " << chrono.lapTimeMs() << " ms, "
+                  << needed_nodes.size() << " needed nodes ("
+                  << (needed_nodes.used_memory() >> 20) << " MiB)"
+                  << std::endl;
+    }
 
-    osmium::io::Reader reader{osm_file};
+    osmium::io::Reader reader{osm_file, plan.main_entities,
+                              osmium::io::read_meta::no};
 
-    index_type index;
-    location_handler_type location_handler{index};
+    std::string location_index = options.location_index;
+    const auto & [index_type_name, index_file] =
+        split_location_index(location_index);
+    if(cache)
+        location_index = cache->location_index();
+    else if(index_type_name == "auto")
+        location_index = auto_location_index(input_file, index_file,
+                                             options.memory_budget);
+    std::unique_ptr<index_type> index =
+        create_location_index(location_index, cached_locations);
+    location_handler_type location_handler{*index};
     location_handler.ignore_errors();
+    // no node location is stored when the cached ones are reused or when
+    // there is no way and no cache to fill
+    const node_id_set_type no_nodes;
+    NeededNodeLocationsForWays needed_location_handler{
+        location_handler,
+        !plan.store_locations ? &no_nodes
+        : needed_nodes_only   ? &needed_nodes_collector.getNeededNodes()
+                              : nullptr};
 
     osmium::ProgressBar progress{reader.file_size(), osmium::isatty(2)};
-    osmium::apply(reader, location_handler, bg_handler,
-                  mp_manager.handler([&bg_handler, &progress, &reader](
-                                         osmium::memory::Buffer && buffer) {
-                      osmium::apply(buffer, bg_handler);
-                      progress.update(reader.offset());
-                  }));
+    if(options.nb_threads > 1) {
+        parallel_apply(reader, needed_location_handler, mp_manager, bg_handler,
+                       progress, options.nb_threads);
+    } else {
+        osmium::apply(reader, needed_location_handler, bg_handler,
+                      mp_manager.handler([&bg_handler, &progress, &reader](
+                                             osmium::memory::Buffer && buffer) {
+                          osmium::apply(buffer, bg_handler);
+                          progress.update(reader.offset());
+                      }));
+    }
     progress.remove();
     progress.update(reader.offset());
     progress.done();
 
     reader.close();
-}
+    std::cout << "Main pass over " << plan.main_entities << " in "
+              << chrono.lapTimeMs() << " ms" << std::endl;
 
-BGDumpHandler query_osm(const std::filesystem::path & input_file,
-                        const std::filesystem::path & patterns_file,
-                        const MultipolygonGeo & search_area) {
-    osmium::io::File osm_file(input_file);
+    print_location_index_footprint(location_index, *index);
+    // the cache is only complete if every node location was stored
+    if(cache && !cached_locations && plan.store_locations) {
+        index.reset();  // unmaps the index file
+        cache->mark_complete();
+    }
+}
 
+BGDumpHandler make_handler(
+    const std::filesystem::path & patterns_file,
+    std::shared_ptr<const PreparedSearchArea> search_area,
+    const QueryOptions & options) {
     std::ifstream patterns_stream(patterns_file);
     nlohmann::json patterns;
     patterns_stream >> patterns;
 
-    BGDumpHandler bg_handler(search_area,
-                             IO::parse_node_patterns(patterns["nodePatterns"]),
+    BGDumpHandler bg_handler(IO::parse_node_patterns(patterns["nodePatterns"]),
                              IO::parse_way_patterns(patterns["wayPatterns"]),
                              IO::parse_area_patterns(patterns["areaPatterns"]));
-    do_query(osm_file, bg_handler);
+    bg_handler.setSearchArea(std::move(search_area));
+    bg_handler.setClip(options.clip);
+    bg_handler.setSimplify(options.simplify);
+    bg_handler.setValidation(options.validation);
+    return bg_handler;
+}
+
+BGDumpHandler query_osm(const std::filesystem::path & input_file,
+                        const std::filesystem::path & patterns_file,
+                        const MultipolygonGeo & search_area,
+                        const QueryOptions & options,
+                        std::shared_ptr<IO::FeatureSink> sink) {
+    BGDumpHandler bg_handler = make_handler(
+        patterns_file,
+        BGDumpHandler::prepare_search_area(search_area, options.predicate_cs),
+        options);
+    bg_handler.setSink(std::move(sink));
+    do_query(input_file, bg_handler, options);
 
     return bg_handler;
-}
\ No newline at end of file
+}
+
+BGDumpHandler query_osm_regions(const std::filesystem::path & input_file,
+                                const std::filesystem::path & patterns_file,
+                                std::shared_ptr<IO::RegionsRouter> regions,
+                                const QueryOptions & options) {
+    // the regions are tested by the router, the handler only discards the
+    // entities outside of their bounding box
+    BGDumpHandler bg_handler = make_handler(patterns_file, nullptr, options);
+    bg_handler.setSearchBox(regions->getBox());
+    bg_handler.setSink(std::move(regions));
+    do_query(input_file, bg_handler, options);
+
+    return bg_handler;
+}
+
+std::vector<BGDumpHandler> query_osm_batch(
+    const std::filesystem::path & input_file,
+    const std::vector<std::filesystem::path> & patterns_files,
+    const MultipolygonGeo & search_area, const QueryOptions & options,
+    const std::vector<std::shared_ptr<IO::FeatureSink>> & sinks) {
+    // the search area is prepared once for all the handlers
+    const std::shared_ptr<const PreparedSearchArea> prepared_area =
+        BGDumpHandler::prepare_search_area(search_area, options.predicate_cs);
+    std::vector<BGDumpHandler> handlers;
+    for(std::size_t i = 0; i < patterns_files.size(); ++i) {
+        handlers.push_back(
+            make_handler(patterns_files[i], prepared_area, options));
+        if(i < sinks.size()) handlers.back().setSink(sinks[i]);
+    }
+    BGDumpHandlerBatch batch(std::move(handlers));
+    do_query(input_file, batch, options);
+
+    return std::move(batch).release();
+}
+
+// Assembles the multipolygon relations matching the area rules of the
+// handler, reading only these relations, their member ways and the nodes of
+// these ways.
+void assemble_matching_relations(const osmium::io::File & osm_file,
+                                 BGDumpHandler & bg_handler) {
+    osmium::area::Assembler::config_type assembler_config;
+    osmium::area::FilteringMultipolygonManager<osmium::area::Assembler>
+        mp_manager{assembler_config, bg_handler.getAreaEnglobingFilter(),
+                   bg_handler.getSearchBox()};
+
+    node_id_set_type member_ways;
+    osmium::io::Reader relations_reader{osm_file,
+                                        osmium::osm_entity_bits::relation,
+                                        osmium::io::read_meta::no};
+    while(osmium::memory::Buffer buffer = relations_reader.read()) {
+        osmium::apply(buffer, mp_manager);
+        for(const auto & relation : buffer.select<osmium::Relation>()) {
+            if(!mp_manager.new_relation(relation)) continue;
+            for(const auto & member : relation.members())
+                if(member.type() == osmium::item_type::way)
+                    member_ways.set(member.positive_ref());
+        }
+    }
+    relations_reader.close();
+    mp_manager.prepare_for_lookup();
+    if(member_ways.empty()) return;
+
+    node_id_set_type needed_nodes;
+    osmium::io::Reader ways_reader{osm_file, osmium::osm_entity_bits::way,
+                                   osmium::io::read_meta::no};
+    while(osmium::memory::Buffer buffer = ways_reader.read())
+        for(const auto & way : buffer.select<osmium::Way>())
+            if(member_ways.get(way.positive_id()))
+                for(const auto & node_ref : way.nodes())
+                    needed_nodes.set(node_ref.positive_ref());
+    ways_reader.close();
+
+    using sparse_index_type =
+        osmium::index::map::SparseMemArray<osmium::unsigned_object_id_type,
+                                           osmium::Location>;
+    sparse_index_type index;
+    osmium::handler::NodeLocationsForWays<sparse_index_type> location_handler{
+        index};
+    location_handler.ignore_errors();
+
+    // the closed member ways are not areas of the search area
+    auto & mp_handler =
+        mp_manager.handler([&bg_handler](osmium::memory::Buffer && buffer) {
+            for(const auto & area : buffer.select<osmium::Area>())
+                if(!area.from_way()) bg_handler.area(area);
+        });
+    osmium::io::Reader reader{osm_file,
+                              osmium::osm_entity_bits::node |
+                                  osmium::osm_entity_bits::way,
+                              osmium::io::read_meta::no};
+    while(osmium::memory::Buffer buffer = reader.read()) {
+        for(const auto & node : buffer.select<osmium::Node>())
+            if(needed_nodes.get(node.positive_id()))
+                location_handler.node(node);
+        for(auto & way : buffer.select<osmium::Way>()) {
+            if(!member_ways.get(way.positive_id())) continue;
+            location_handler.way(way);
+            mp_handler.way(way);
+        }
+    }
+    mp_handler.flush();
+    reader.close();
+}
+
+MultipolygonGeo query_osm_search_area(
+    const std::filesystem::path & input_file,
+    const std::filesystem::path & search_area_pattern_file,
+    const QueryOptions & options) {
+    std::ifstream patterns_stream(search_area_pattern_file);
+    nlohmann::json patterns;
+    patterns_stream >> patterns;
+
+    // the search area of a given input, patterns and validation mode is
+    // cached as WKT, after a line holding the patterns and the mode that
+    // tells the digest collisions apart
+    std::filesystem::path cache_file;
+    const std::string cache_key =
+        std::to_string(static_cast<int>(options.validation)) + ' ' +
+        patterns.dump();
+    if(!options.cache_dir.empty()) {
+        char digest[17];
+        std::snprintf(digest, sizeof(digest), "%016llx",
+                      static_cast<unsigned long long>(fnv1a(cache_key)));
+        cache_file = options.cache_dir /
+                     (InputCache::input_key(input_file) + "-area-" + digest +
+                      ".wkt");
+        std::string key, wkt;
+        if(std::ifstream cached{cache_file};
+           std::getline(cached, key) && key == cache_key &&
+           std::getline(cached, wkt)) {
+            MultipolygonGeo search_area;
+            bg::read_wkt(wkt, search_area);
+            return search_area;
+        }
+    }
+
+    BGDumpHandler bg_handler(
+        std::vector<RulesIndex<NodeBuilder>::Rule>{},
+        std::vector<RulesIndex<WayBuilder>::Rule>{},
+        IO::parse_area_patterns(patterns["areaPatterns"]));
+    bg_handler.setValidation(options.validation);
+    assemble_matching_relations(osmium::io::File{input_file.string()},
+                                bg_handler);
+
+    const std::vector<Area> & areas = bg_handler.getAreas();
+    if(areas.empty())
+        throw std::runtime_error("no relation of " + input_file.string() +
+                                 " matches the area patterns of " +
+                                 search_area_pattern_file.string());
+    MultipolygonGeo search_area =
+        convert_geometry<MultipolygonGeo>(areas.front().multipolygon);
+    for(std::size_t i = 1; i < areas.size(); ++i) {
+        MultipolygonGeo area_union;
+        bg::union_(search_area,
+                   convert_geometry<MultipolygonGeo>(areas[i].multipolygon),
+                   area_union);
+        search_area = std::move(area_union);
+    }
+
+    if(!cache_file.empty()) {
+        // written aside then renamed, so that an interrupted write leaves no
+        // truncated cache file
+        std::filesystem::create_directories(options.cache_dir);
+        std::filesystem::path tmp_file = cache_file;
+        tmp_file += ".tmp";
+        {
+            std::ofstream cached{tmp_file};
+            cached << cache_key << '\n'
+                   << std::setprecision(
+                          std::numeric_limits<double>::max_digits10)
+                   << bg::wkt(search_area) << '\n';
+            if(!cached)
+                throw std::runtime_error("cannot write " + tmp_file.string());
+        }
+        std::filesystem::rename(tmp_file, cache_file);
+    }
+    return search_area;
+}
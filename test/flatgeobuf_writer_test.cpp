@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "bg_types.hpp"
+#include "io/flatgeobuf_writer.hpp"
+
+namespace {
+template <typename T>
+T read(const std::uint8_t * p) {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+// reader of the flatbuffers tables of the FlatGeobuf schema
+class Table {
+private:
+    const std::uint8_t * start;
+    const std::uint8_t * vtable;
+
+    std::uint16_t fieldOffset(std::uint16_t id) const {
+        const std::uint16_t vtable_size = read<std::uint16_t>(vtable);
+        if(4u + 2u * id >= vtable_size) return 0;
+        return read<std::uint16_t>(vtable + 4 + 2 * id);
+    }
+    const std::uint8_t * target(std::uint16_t id) const {
+        const std::uint8_t * pos = start + fieldOffset(id);
+        return pos + read<std::uint32_t>(pos);
+    }
+
+public:
+    explicit Table(const std::uint8_t * p_table)
+        : start(p_table), vtable(p_table - read<std::int32_t>(p_table)) {}
+    static Table root(const std::uint8_t * buffer) {
+        return Table(buffer + read<std::uint32_t>(buffer));
+    }
+
+    bool has(std::uint16_t id) const { return fieldOffset(id) != 0; }
+
+    template <typename T>
+    T scalar(std::uint16_t id) const {
+        return has(id) ? read<T>(start + fieldOffset(id)) : T{0};
+    }
+    template <typename T>
+    std::vector<T> vector(std::uint16_t id) const {
+        if(!has(id)) return {};
+        const std::uint8_t * v = target(id);
+        std::vector<T> values(read<std::uint32_t>(v));
+        std::memcpy(values.data(), v + 4, values.size() * sizeof(T));
+        return values;
+    }
+    std::string string(std::uint16_t id) const {
+        const std::uint8_t * s = target(id);
+        return std::string(reinterpret_cast<const char *>(s + 4),
+                           read<std::uint32_t>(s));
+    }
+    Table child(std::uint16_t id) const { return Table(target(id)); }
+    std::vector<Table> tables(std::uint16_t id) const {
+        std::vector<Table> tables;
+        if(!has(id)) return tables;
+        const std::uint8_t * v = target(id);
+        const std::uint32_t n = read<std::uint32_t>(v);
+        for(std::uint32_t i = 0; i < n; ++i) {
+            const std::uint8_t * pos = v + 4 + 4 * i;
+            tables.emplace_back(pos + read<std::uint32_t>(pos));
+        }
+        return tables;
+    }
+};
+
+struct NodeItem {
+    double min_x, min_y, max_x, max_y;
+    std::uint64_t offset;
+};
+
+struct Geometry {
+    std::uint8_t type;
+    std::vector<double> xy;
+    std::vector<std::uint32_t> ends;
+    std::vector<Geometry> parts;
+
+    explicit Geometry(const Table & geometry)
+        : type(geometry.scalar<std::uint8_t>(6))
+        , xy(geometry.vector<double>(1))
+        , ends(geometry.vector<std::uint32_t>(0)) {
+        for(const Table & part : geometry.tables(7)) parts.emplace_back(part);
+    }
+};
+
+struct Feature {
+    std::uint64_t offset;
+    std::uint32_t size;
+    Geometry geometry;
+    std::map<std::string, std::string> properties;
+};
+
+// parses a whole FlatGeobuf file, checking its layout
+struct FlatGeobufFile {
+    std::vector<std::uint8_t> bytes;
+    std::uint32_t header_size;
+    std::uint64_t features_count;
+    std::uint16_t node_size;
+    std::vector<double> envelope;
+    std::vector<std::string> columns;
+    std::vector<NodeItem> nodes;
+    std::size_t features_start;
+    std::vector<Feature> features;
+
+    explicit FlatGeobufFile(const std::filesystem::path & path) {
+        std::ifstream file(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+        const std::uint8_t magic[8] = {'f', 'g', 'b', 3, 'f', 'g', 'b', 0};
+        EXPECT_EQ(std::memcmp(bytes.data(), magic, 8), 0);
+
+        header_size = read<std::uint32_t>(bytes.data() + 8);
+        const Table header = Table::root(bytes.data() + 12);
+        EXPECT_EQ(header.string(0), path.stem().string());
+        EXPECT_EQ(header.scalar<std::uint8_t>(2), 0);  // unknown type
+        features_count = header.scalar<std::uint64_t>(8);
+        node_size = header.scalar<std::uint16_t>(9);
+        envelope = header.vector<double>(1);
+        for(const Table & column : header.tables(7)) {
+            columns.push_back(column.string(0));
+            EXPECT_EQ(column.scalar<std::uint8_t>(1), 11);  // string
+        }
+        const Table crs = header.child(10);
+        EXPECT_EQ(crs.string(0), "EPSG");
+        EXPECT_EQ(crs.scalar<std::int32_t>(1), 4326);
+
+        const std::size_t index_start = 12 + header_size;
+        nodes.resize(nb_nodes(features_count, node_size));
+        std::memcpy(nodes.data(), bytes.data() + index_start,
+                    nodes.size() * sizeof(NodeItem));
+        features_start = index_start + nodes.size() * sizeof(NodeItem);
+
+        for(std::size_t i = nodes.size() - features_count; i < nodes.size();
+            ++i) {
+            const std::uint8_t * f =
+                bytes.data() + features_start + nodes[i].offset;
+            const Table feature = Table::root(f + 4);
+            Feature & parsed = features.emplace_back(
+                Feature{nodes[i].offset, read<std::uint32_t>(f),
+                        Geometry(feature.child(0)),
+                        {}});
+            const std::vector<std::uint8_t> properties =
+                feature.vector<std::uint8_t>(1);
+            for(std::size_t pos = 0; pos < properties.size();) {
+                const auto column =
+                    read<std::uint16_t>(properties.data() + pos);
+                const auto length =
+                    read<std::uint32_t>(properties.data() + pos + 2);
+                parsed.properties[columns.at(column)] = std::string(
+                    reinterpret_cast<const char *>(properties.data()) + pos +
+                        6,
+                    length);
+                pos += 6 + length;
+            }
+        }
+    }
+
+    // number of nodes of the packed R-tree, including the leaves
+    static std::size_t nb_nodes(std::uint64_t nb_features,
+                                std::uint16_t node_size) {
+        if(nb_features == 0) return 0;
+        std::size_t n = nb_features;
+        std::size_t nb = n;
+        do {
+            n = (n + node_size - 1) / node_size;
+            nb += n;
+        } while(n != 1);
+        return nb;
+    }
+};
+
+Properties make_properties(
+    std::vector<std::pair<std::string, std::string>> properties) {
+    return Properties(properties);
+}
+
+std::filesystem::path test_file(const std::string & name) {
+    return std::filesystem::temp_directory_path() / (name + ".fgb");
+}
+}  // namespace
+
+TEST(FlatGeobufWriter, RoundTripsGeometriesAndProperties) {
+    const std::filesystem::path path = test_file("round_trip");
+    {
+        IO::FlatGeobufWriter writer(path);
+        writer.write(Node(PointGeo(2.5, 48.25),
+                          make_properties({{"id", "node"}, {"name", "A"}})));
+        writer.write(
+            Way(LinestringGeo{{2.0, 48.0}, {2.125, 48.5}, {2.25, 48.75}},
+                make_properties({{"id", "way"}, {"highway", "primary"}})));
+        MultipolygonGeo mp;
+        mp.resize(2);
+        mp[0].outer() = {{0, 0}, {0, 4}, {4, 4}, {4, 0}, {0, 0}};
+        mp[0].inners().push_back({{1, 1}, {2, 1}, {2, 2}, {1, 2}, {1, 1}});
+        mp[1].outer() = {{5, 5}, {5, 6}, {6, 6}, {6, 5}, {5, 5}};
+        writer.write(Area(mp, make_properties({{"id", "area"},
+                                               {"name", "Bois \"B\""}})));
+        writer.close();
+    }
+
+    const FlatGeobufFile fgb(path);
+    EXPECT_EQ(fgb.features_count, 3u);
+    EXPECT_EQ(fgb.node_size, 16u);
+    EXPECT_EQ(fgb.columns,
+              (std::vector<std::string>{"id", "name", "highway"}));
+    EXPECT_EQ(fgb.envelope, (std::vector<double>{0, 0, 6, 48.75}));
+    // 3 leaves and the root
+    ASSERT_EQ(fgb.nodes.size(), 4u);
+    ASSERT_EQ(fgb.features.size(), 3u);
+
+    std::map<std::string, const Feature *> features;
+    for(const Feature & feature : fgb.features)
+        features[feature.properties.at("id")] = &feature;
+    ASSERT_EQ(features.size(), 3u);
+
+    const Feature & node = *features.at("node");
+    EXPECT_EQ(node.geometry.type, 1);
+    EXPECT_EQ(node.geometry.xy, (std::vector<double>{2.5, 48.25}));
+    EXPECT_EQ(node.properties.at("name"), "A");
+    EXPECT_EQ(node.properties.size(), 2u);
+
+    const Feature & way = *features.at("way");
+    EXPECT_EQ(way.geometry.type, 2);
+    EXPECT_EQ(way.geometry.xy,
+              (std::vector<double>{2.0, 48.0, 2.125, 48.5, 2.25, 48.75}));
+    EXPECT_EQ(way.properties.at("highway"), "primary");
+
+    const Feature & area = *features.at("area");
+    EXPECT_EQ(area.geometry.type, 6);
+    EXPECT_EQ(area.properties.at("name"), "Bois \"B\"");
+    ASSERT_EQ(area.geometry.parts.size(), 2u);
+    const Geometry & holed = area.geometry.parts[0];
+    EXPECT_EQ(holed.type, 3);
+    EXPECT_EQ(holed.ends, (std::vector<std::uint32_t>{5, 10}));
+    EXPECT_EQ(holed.xy, (std::vector<double>{0, 0, 0, 4, 4, 4, 4, 0, 0, 0,
+                                             1, 1, 2, 1, 2, 2, 1, 2, 1, 1}));
+    const Geometry & square = area.geometry.parts[1];
+    EXPECT_EQ(square.type, 3);
+    EXPECT_TRUE(square.ends.empty());
+    EXPECT_EQ(square.xy, (std::vector<double>{5, 5, 5, 6, 6, 6, 6, 5, 5, 5}));
+
+    // the leaves hold the feature bounds
+    const NodeItem & area_leaf = fgb.nodes[1 + (&area - fgb.features.data())];
+    EXPECT_EQ(area_leaf.min_x, 0);
+    EXPECT_EQ(area_leaf.min_y, 0);
+    EXPECT_EQ(area_leaf.max_x, 6);
+    EXPECT_EQ(area_leaf.max_y, 6);
+    std::filesystem::remove(path);
+}
+
+TEST(FlatGeobufWriter, PacksTheRTreeOverContiguousFeatures) {
+    const std::filesystem::path path = test_file("rtree");
+    const std::size_t nb_features = 300;
+    {
+        // a small buffer flushes the features many times
+        IO::FlatGeobufWriter writer(path, 256);
+        for(std::size_t i = 0; i < nb_features; ++i) {
+            const double x = static_cast<double>(i % 20);
+            const double y = static_cast<double>(i / 20);
+            writer.write(Way(LinestringGeo{{x, y}, {x + 0.5, y + 0.25}},
+                             make_properties({{"id", std::to_string(i)}})));
+        }
+        writer.close();
+    }
+
+    const FlatGeobufFile fgb(path);
+    ASSERT_EQ(fgb.features_count, nb_features);
+    // 300 leaves, 19 nodes above them, 2 above these, then the root
+    ASSERT_EQ(fgb.nodes.size(), nb_features + 19 + 2 + 1);
+    const NodeItem & root = fgb.nodes[0];
+    EXPECT_EQ((std::vector<double>{root.min_x, root.min_y, root.max_x,
+                                   root.max_y}),
+              fgb.envelope);
+    EXPECT_EQ(fgb.envelope, (std::vector<double>{0, 0, 19.5, 14.25}));
+
+    // each internal node points to its first child and bounds its children
+    const std::size_t first_leaf = fgb.nodes.size() - nb_features;
+    std::size_t level_end = fgb.nodes.size();
+    for(std::size_t i = 0; i < first_leaf; ++i) {
+        const NodeItem & node = fgb.nodes[i];
+        const std::size_t first_child = node.offset;
+        ASSERT_GT(first_child, i);
+        ASSERT_LT(first_child, fgb.nodes.size());
+        const std::size_t next_parent_child =
+            i + 1 < first_leaf && fgb.nodes[i + 1].offset > first_child
+                ? fgb.nodes[i + 1].offset
+                : std::min(first_child + fgb.node_size, level_end);
+        double min_x = std::numeric_limits<double>::infinity();
+        double min_y = min_x, max_x = -min_x, max_y = -min_x;
+        for(std::size_t c = first_child; c < next_parent_child; ++c) {
+            min_x = std::min(min_x, fgb.nodes[c].min_x);
+            min_y = std::min(min_y, fgb.nodes[c].min_y);
+            max_x = std::max(max_x, fgb.nodes[c].max_x);
+            max_y = std::max(max_y, fgb.nodes[c].max_y);
+        }
+        EXPECT_EQ(node.min_x, min_x);
+        EXPECT_EQ(node.min_y, min_y);
+        EXPECT_EQ(node.max_x, max_x);
+        EXPECT_EQ(node.max_y, max_y);
+    }
+
+    // the leaves point to contiguous features, in the order of the leaves,
+    // whose geometries match their bounds
+    std::uint64_t offset = 0;
+    std::vector<bool> seen(nb_features, false);
+    for(std::size_t i = 0; i < nb_features; ++i) {
+        const NodeItem & leaf = fgb.nodes[first_leaf + i];
+        const Feature & feature = fgb.features[i];
+        EXPECT_EQ(leaf.offset, offset);
+        offset += 4 + feature.size;
+        const std::vector<double> & xy = feature.geometry.xy;
+        ASSERT_EQ(xy.size(), 4u);
+        EXPECT_EQ(leaf.min_x, xy[0]);
+        EXPECT_EQ(leaf.min_y, xy[1]);
+        EXPECT_EQ(leaf.max_x, xy[2]);
+        EXPECT_EQ(leaf.max_y, xy[3]);
+        const std::size_t id = std::stoul(feature.properties.at("id"));
+        EXPECT_EQ(xy[0], static_cast<double>(id % 20));
+        EXPECT_EQ(xy[1], static_cast<double>(id / 20));
+        seen[id] = true;
+    }
+    EXPECT_EQ(fgb.features_start + offset, fgb.bytes.size());
+    EXPECT_EQ(std::count(seen.begin(), seen.end(), true),
+              static_cast<std::ptrdiff_t>(nb_features));
+    std::filesystem::remove(path);
+}
+
+TEST(FlatGeobufWriter, WritesAnEmptyFileWithoutIndex) {
+    const std::filesystem::path path = test_file("empty");
+    IO::FlatGeobufWriter(path).close();
+
+    const FlatGeobufFile fgb(path);
+    EXPECT_EQ(fgb.features_count, 0u);
+    EXPECT_EQ(fgb.node_size, 0u);
+    EXPECT_TRUE(fgb.envelope.empty());
+    EXPECT_TRUE(fgb.columns.empty());
+    EXPECT_EQ(fgb.features_start, fgb.bytes.size());
+    std::filesystem::remove(path);
+}